@@ -0,0 +1,99 @@
+//
+//  asset_loader.h
+//  3D Object Drawing
+//
+//  Worker threads for the file work done at startup: reading shader sources,
+//  mapping and validating the scene file, computing mesh bounds. A job returns
+//  a std::future; the render thread polls it with isReady() once per frame and
+//  does the GL part (compiling, uploading) when the data is there, so the
+//  window shows frames from the start instead of after everything is loaded.
+//
+
+#ifndef ASSET_LOADER_H
+#define ASSET_LOADER_H
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class AssetLoader
+{
+public:
+    // threads = 0 picks one less than the number of cores, at least one; a core count the
+    // platform cannot tell (0) counts as one
+    explicit AssetLoader(unsigned int threads = 0) : stopping(false)
+    {
+        if (threads == 0)
+            threads = std::max(2u, std::thread::hardware_concurrency()) - 1;
+        for (unsigned int i = 0; i < threads; i++)
+            workers.push_back(std::thread(&AssetLoader::work, this));
+    }
+
+    // jobs already queued still run
+    ~AssetLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    // run job() on a worker; it must not touch GL, the context belongs to the render thread
+    template <typename Job>
+    std::future<typename std::result_of<Job()>::type> submit(Job job)
+    {
+        typedef typename std::result_of<Job()>::type Result;
+        // std::function needs a copyable callable, so the task is shared
+        std::shared_ptr<std::packaged_task<Result()> > task = std::make_shared<std::packaged_task<Result()> >(job);
+        std::future<Result> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push_back([task]() { (*task)(); });
+        }
+        wake.notify_one();
+        return result;
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()> > jobs;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping;
+
+    void work()
+    {
+        for (;;)
+        {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this]() { return stopping || !jobs.empty(); });
+                if (jobs.empty())
+                    return;
+                job = std::move(jobs.front());
+                jobs.pop_front();
+            }
+            job();
+        }
+    }
+};
+
+// true when get() would not block
+template <typename T>
+bool isReady(const std::future<T>& result)
+{
+    return result.valid() && result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+#endif
@@ -0,0 +1,263 @@
+//
+//  bedroom.h
+//  3D Object Drawing
+//
+//  The built-in bedroom, described as prefabs for the scene file format.
+//  Used when no scene file is given and by --export-scene. The prefabs and
+//  where the room puts them are kept apart, so stress_scene.h can place the
+//  same furniture in many rooms.
+//
+
+#ifndef BEDROOM_H
+#define BEDROOM_H
+
+#include <glm/glm.hpp>
+
+#include "fan.h"
+#include "procedural_mesh.h"
+#include "scene_file.h"
+
+#include <vector>
+
+// the bedroom's prefabs and the instances that make up one room
+struct BedroomLayout
+{
+    struct Piece
+    {
+        unsigned int prefab;
+        Transform placement;
+        // free-standing furniture; the room shell and what hangs on a wall or the ceiling stays put
+        bool movable;
+
+        Piece(unsigned int prefab, const Transform& placement, bool movable) : prefab(prefab), placement(placement), movable(movable)
+        {
+        }
+    };
+    std::vector<Piece> pieces;
+    // index of the fan in pieces
+    size_t fan;
+    // what the fan is made of, to build it once more
+    unsigned int cubeMesh;
+    unsigned int fanHolderMaterial, fanRodMaterial, fanBladeMaterial;
+};
+
+// meshes, materials and prefabs of the bedroom; adds no instances
+inline BedroomLayout buildBedroomPrefabs(SceneBuilder& builder)
+{
+    BedroomLayout layout;
+
+    // one cube shared by every piece of furniture; the color comes from the material
+    float cube_vertices[] = {
+        0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
+        0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
+        0.5f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f,
+        0.0f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f,
+
+        0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
+        0.5f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f,
+        0.5f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f,
+        0.5f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f,
+
+        0.0f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f,
+        0.5f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f,
+        0.5f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f,
+        0.0f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f,
+
+        0.0f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f,
+        0.0f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f,
+        0.0f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f,
+        0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
+
+        0.5f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f,
+        0.5f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f,
+        0.0f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f,
+        0.0f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f,
+
+        0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
+        0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
+        0.5f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f,
+        0.0f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f
+    };
+    unsigned int cube_indices[] = {
+        0, 3, 2,
+        2, 1, 0,
+
+        4, 5, 7,
+        7, 6, 4,
+
+        8, 9, 10,
+        10, 11, 8,
+
+        12, 13, 14,
+        14, 15, 12,
+
+        16, 17, 18,
+        18, 19, 16,
+
+        20, 21, 22,
+        22, 23, 20
+    };
+
+    float ac[] = {
+        0.0f, 0.0f, 0.0f,0.2f, 0.2f, 0.2f,
+        0.25f, 0.0f, 0.0f, 0.2f, 0.2f, 0.2f,
+        0.25f, 0.25f, 0.0f, 0.2f, 0.2f, 0.2f,
+        0.0f, 0.5f, 0.0f, 0.2f, 0.2f, 0.2f,
+
+        0.25f, 0.0f, 0.0f, 0.8f, 0.8f, 0.8f,
+        0.25f, 0.25f, 0.0f, 0.8f, 0.8f, 0.8f,
+        0.25f, 0.0f, 0.5f, 0.8f, 0.8f, 0.8f,
+        0.25f, 0.25f, 0.5f, 0.8f, 0.8f, 0.8f,
+
+        0.0f, 0.0f, 0.5f, 0.2f, 0.2f, 0.2f,
+        0.25f, 0.0f, 0.5f, 0.2f, 0.2f, 0.2f,
+        0.25f, 0.25f, 0.5f, 0.2f, 0.2f, 0.2f,
+        0.0f, 0.5f, 0.5f, 0.2f, 0.2f, 0.2f,
+
+        0.0f, 0.0f, 0.5f, 0.2f, 0.2f, 0.2f,
+        0.0f, 0.5f, 0.5f, 0.2f, 0.2f, 0.2f,
+        0.0f, 0.5f, 0.0f, 0.2f, 0.2f, 0.2f,
+        0.0f, 0.0f, 0.0f, 0.2f, 0.2f, 0.2f,
+
+        0.25f, 0.25f, 0.5f, 0.2f, 0.2f, 0.2f,
+        0.25f, 0.25f, 0.0f, 0.2f, 0.2f, 0.2f,
+        0.0f, 0.5f, 0.0f, 0.2f, 0.2f, 0.2f,
+        0.0f, 0.5f, 0.5f, 0.2f, 0.2f, 0.2f,
+
+        0.0f, 0.0f, 0.0f, 0.2f, 0.2f, 0.2f,
+        0.25f, 0.0f, 0.0f, 0.2f, 0.2f, 0.2f,
+        0.25f, 0.0f, 0.5f, 0.2f, 0.2f, 0.2f,
+        0.0f, 0.0f, 0.5f, 0.2f, 0.2f, 0.2f
+    };
+
+    unsigned int cube = builder.addMesh(cube_vertices, sizeof(cube_vertices), cube_indices, sizeof(cube_indices));
+    unsigned int acMesh = builder.addMesh(ac, sizeof(ac), cube_indices, sizeof(cube_indices));
+    // the lamp shade is a cone cut short, closed at both ends; 8 segments far away, up to 64 up close
+    unsigned int lampShade = builder.addLodChain(makeLodChain([](unsigned int segments) {
+        return makeFrustum(0.5f, 0.25f, -0.3f, 0.7f, segments, true, glm::vec3(0.0f, 1.0f, 1.0f));
+    }, 64, 8));
+
+    // materials: adding a furniture color costs a table entry, not new buffers
+    unsigned int floorMaterial = builder.addMaterial("floor", glm::vec3(0.69f, 0.69f, 0.69f));
+    unsigned int ceilingMaterial = builder.addMaterial("ceiling", glm::vec3(0.95f, 0.95f, 0.95f));
+    unsigned int wall1Material = builder.addMaterial("wall1", glm::vec3(0.92f, 0.91f, 0.83f));
+    unsigned int wall2Material = builder.addMaterial("wall2", glm::vec3(0.99f, 0.84f, 0.70f));
+    unsigned int boxMaterial = builder.addMaterial("box", glm::vec3(0.647f, 0.165f, 0.165f));
+    unsigned int box2Material = builder.addMaterial("box2", glm::vec3(0.1f, 0.714f, 0.757f));
+    unsigned int fanHolderMaterial = builder.addMaterial("fan_holder", glm::vec3(1.0f, 1.0f, 1.0f));
+    unsigned int fanPivotMaterial = builder.addMaterial("fan_pivot", glm::vec3(.44f, .22f, .05f));
+    unsigned int fanBladeMaterial = builder.addMaterial("fan_blade", glm::vec3(.0f, .0f, .42f));
+    // see-through: drawn after everything opaque, blended over the window frame
+    unsigned int glassMaterial = builder.addMaterial("glass", glm::vec3(0.53f, 0.8f, 0.98f), 0.5f);
+    unsigned int cabinateMaterial = builder.addMaterial("cabinate", glm::vec3(0.29f, 0.0f, 0.29f));
+    // meshes that carry their own vertex colors
+    unsigned int vertexColorMaterial = builder.addMaterial("vertex_color", glm::vec3(1.0f, 1.0f, 1.0f));
+    // the lamp shade has always been drawn without its color attribute, i.e. black
+    unsigned int lampShadeMaterial = builder.addMaterial("lamp_shade", glm::vec3(0.0f, 0.0f, 0.0f));
+
+    // prefabs: parts are placed relative to the prefab origin, instances place the prefab in the room
+    //Room: floor, ceiling and walls
+    // together they bound the room as a cell for portal culling
+    unsigned int roomPrefab = builder.beginPrefab("Room");
+    //Floor
+    builder.addPart(cube, floorMaterial, Transform(0, 0, 0, 0, 0, 0, 20, 0.1, 20), -1, SCENE_PART_CELL);
+    //Ceiling
+    builder.addPart(cube, ceilingMaterial, Transform(0, 5, 0, 0, 0, 0, 20, 0.1, 20), -1, SCENE_PART_CELL);
+    //Wall1
+    builder.addPart(cube, wall1Material, Transform(0, 0, 0, 0, 0, 0, 20, 10, 0.1), -1, SCENE_PART_CELL);
+    builder.addPart(cube, wall1Material, Transform(0, 0, 10, 0, 0, 0, 20, 10, 0.1), -1, SCENE_PART_CELL);
+    //Wall2
+    builder.addPart(cube, wall2Material, Transform(10, 0, 0, 0, 0, 0, 0.1, 10, 20), -1, SCENE_PART_CELL);
+    layout.pieces.push_back(BedroomLayout::Piece(roomPrefab, Transform(), false));
+
+    //Bed
+    unsigned int bedPrefab = builder.beginPrefab("Bed");
+    builder.addPart(cube, boxMaterial, Transform(0, 0, 0, 0, 0, 0, -7, 1.5, 6));
+    builder.addPart(cube, boxMaterial, Transform(0, 0, 0, 0, 0, 0, -1, 3.5, 6));
+    builder.addPart(cube, fanPivotMaterial, Transform(0, 0, -.05, 0, 0, 0, -1, 3.5, .1));
+    builder.addPart(cube, fanPivotMaterial, Transform(0, 0, 3, 0, 0, 0, -1, 3.5, .1));
+    builder.addPart(cube, fanPivotMaterial, Transform(0, 1.75, -.05, 0, 0, 0, -1, .1, 6.2));
+    builder.addPart(cube, box2Material, Transform(-4, 0, .75, 0, 0, 0, -3, 0.2, 3));
+    builder.addPart(cube, wall1Material, Transform(-.5, .75, 0, 0, 0, 0, -6, 0.5, 6));
+    builder.addPart(cube, box2Material, Transform(-.5, .95, .25, 0, 0, 0, -2, .2, 2));
+    builder.addPart(cube, box2Material, Transform(-.5, .95, 1.75, 0, 0, 0, -2, .2, 2));
+    layout.pieces.push_back(BedroomLayout::Piece(bedPrefab, Transform(10, 0, 3), true));
+
+    //Table
+    unsigned int tablePrefab = builder.beginPrefab("Table");
+    builder.addPart(cube, fanPivotMaterial, Transform(0, .95, 0, 0, 0, 0, -4, .5, 5));
+    builder.addPart(cube, boxMaterial, Transform(-1.75, 0, 0, 0, 0, 0, -.5, 2, .5));
+    builder.addPart(cube, boxMaterial, Transform(0, 0, 0, 0, 0, 0, -.5, 2, .5));
+    builder.addPart(cube, boxMaterial, Transform(-1.75, 0, 2.25, 0, 0, 0, -.5, 2, .5));
+    builder.addPart(cube, boxMaterial, Transform(0, 0, 2.25, 0, 0, 0, -.5, 2, .5));
+    layout.pieces.push_back(BedroomLayout::Piece(tablePrefab, Transform(10, 0, 7), true));
+
+    //Chair
+    unsigned int chairPrefab = builder.beginPrefab("Chair");
+    builder.addPart(cube, fanPivotMaterial, Transform(.75, .5, 0, 0, 0, 0, -2, .5, 2));
+    builder.addPart(cube, boxMaterial, Transform(0, 0, 0, 0, 0, 0, -.25, 1, .25));
+    builder.addPart(cube, boxMaterial, Transform(0, 0, .85, 0, 0, 0, -.25, 1, .25));
+    builder.addPart(cube, boxMaterial, Transform(.75, 0, .85, 0, 0, 0, -.25, 1, .25));
+    builder.addPart(cube, boxMaterial, Transform(.75, 0, .03, 0, 0, 0, -.25, 1, .25));
+    builder.addPart(cube, boxMaterial, Transform(-.18, .75, .07, 0, 0, 0, -.15, 1.65, .15));
+    builder.addPart(cube, boxMaterial, Transform(-.18, .75, .85, 0, 0, 0, -.15, 1.65, .15));
+    builder.addPart(cube, fanPivotMaterial, Transform(-.2, 1.75, 0, 0, 0, 0, -.15, -1.5, 2));
+    layout.pieces.push_back(BedroomLayout::Piece(chairPrefab, Transform(8, 0, 7.75), true));
+
+    //AC
+    unsigned int acPrefab = builder.beginPrefab("AC");
+    builder.addPart(acMesh, vertexColorMaterial, Transform(0, 0, 0, 0, 0, 0, -5, 2, 6));
+    layout.pieces.push_back(BedroomLayout::Piece(acPrefab, Transform(10, 3, 4), false));
+
+    //Cabinate
+    unsigned int cabinatePrefab = builder.beginPrefab("Cabinate");
+    builder.addPart(cube, cabinateMaterial, Transform(0, 0, 0, 0, 0, 0, -6, 4, 2));
+    builder.addPart(cube, box2Material, Transform(0, 2, 0, 0, 0, 0, -6.115, .15, 2.115));
+    builder.addPart(cube, box2Material, Transform(0, 1.5, 0, 0, 0, 0, -6.115, .15, 2.115));
+    builder.addPart(cube, box2Material, Transform(0, 1, 0, 0, 0, 0, -6.115, .15, 2.115));
+    builder.addPart(cube, box2Material, Transform(0, .5, 0, 0, 0, 0, -6.115, .15, 2.115));
+    builder.addPart(cube, box2Material, Transform(0, 0, 0, 0, 0, 0, -6.115, .15, 2.115));
+    layout.pieces.push_back(BedroomLayout::Piece(cabinatePrefab, Transform(10, 0, 0), true));
+
+    //Mirror
+    unsigned int mirrorPrefab = builder.beginPrefab("Mirror");
+    builder.addPart(cube, boxMaterial, Transform(0, .5, 0, 0, 0, 0, -.15, 5, 2.5));
+    builder.addPart(cube, fanHolderMaterial, Transform(-.02, .62, .13, 0, 0, 0, -.17, 4.5, 2));
+    layout.pieces.push_back(BedroomLayout::Piece(mirrorPrefab, Transform(10, 0, 1.45), false));
+
+    //Window: each pane is a portal into the room behind the wall
+    unsigned int windowPrefab = builder.beginPrefab("Window");
+    builder.addPart(cube, boxMaterial, Transform(0, 0, 0, 0, 0, 0, 7, 5, -.15));
+    builder.addPart(cube, glassMaterial, Transform(.15, .15, 0, 0, 0, 0, 2, 4.5, -.151), -1, SCENE_PART_PORTAL);
+    builder.addPart(cube, glassMaterial, Transform(1.25, .15, 0, 0, 0, 0, 2, 4.5, -.151), -1, SCENE_PART_PORTAL);
+    builder.addPart(cube, glassMaterial, Transform(2.35, .15, 0, 0, 0, 0, 2, 4.5, -.151), -1, SCENE_PART_PORTAL);
+    layout.pieces.push_back(BedroomLayout::Piece(windowPrefab, Transform(3, 1.5, 10), false));
+
+    //Lamp
+    unsigned int lampPrefab = builder.beginPrefab("Lamp");
+    builder.addPart(lampShade, lampShadeMaterial, Transform(0, 2, 0, 0, 0, 0, 1, 1, 1));
+    builder.addPart(cube, fanPivotMaterial, Transform(0, 0, 0, 0, 0, 0, .15, 5, .15));
+    builder.addPart(cube, fanPivotMaterial, Transform(-.05, 0, -.15, 0, 0, 0, .6, .6, .6));
+    layout.pieces.push_back(BedroomLayout::Piece(lampPrefab, Transform(6, 0, .5), true));
+
+    //Fan
+    Fan fan;
+    unsigned int fanPrefab = fan.build(builder, cube, fanHolderMaterial, fanPivotMaterial, fanBladeMaterial);
+    layout.fan = layout.pieces.size();
+    layout.pieces.push_back(BedroomLayout::Piece(fanPrefab, Transform(fan.pivot.x, fan.pivot.y, fan.pivot.z), false));
+
+    layout.cubeMesh = cube;
+    layout.fanHolderMaterial = fanHolderMaterial;
+    layout.fanRodMaterial = fanPivotMaterial;
+    layout.fanBladeMaterial = fanBladeMaterial;
+    return layout;
+}
+
+inline void buildBedroom(SceneBuilder& builder)
+{
+    BedroomLayout layout = buildBedroomPrefabs(builder);
+    for (const BedroomLayout::Piece& piece : layout.pieces)
+        builder.addInstance(piece.prefab, piece.placement);
+}
+
+#endif
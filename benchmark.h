@@ -0,0 +1,151 @@
+//
+//  benchmark.h
+//  3D Object Drawing
+//
+//  Micro-benchmarks. The uniform upload runs inside the application's GL
+//  context; the transform benchmark needs no context.
+//
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "object_buffer.h"
+#include "shader.h"
+#include "static_scene.h"
+#include "transform_batch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Per-frame cost of uploading the model matrix for every object, measured three ways:
+//   lookup - the old path: build a std::string and ask the driver for the location on every call
+//   cached - setMat4(name) answered from the table reflected at link time
+//   handle - a Uniform<glm::mat4> resolved once before the loop
+// The shader must be in use. Results are CPU microseconds per frame.
+inline void benchmarkUniformUpload(const Shader& shader, int frames = 1000, int objectsPerFrame = 60)
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    glm::mat4 model(1.0f);
+
+    // warm up the driver so the first variant is not charged for it
+    for (int i = 0; i < objectsPerFrame; i++)
+        shader.setMat4("model", model);
+    glFinish();
+
+    Clock::time_point start = Clock::now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        model[3][0] = (float)frame;
+        for (int i = 0; i < objectsPerFrame; i++)
+        {
+            std::string name("model");
+            glUniformMatrix4fv(glGetUniformLocation(shader.ID, name.c_str()), 1, GL_FALSE, &model[0][0]);
+        }
+    }
+    glFinish();
+    double lookup = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+    start = Clock::now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        model[3][0] = (float)frame;
+        for (int i = 0; i < objectsPerFrame; i++)
+            shader.setMat4("model", model);
+    }
+    glFinish();
+    double cached = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+    Uniform<glm::mat4> modelUniform = shader.uniform<glm::mat4>("model");
+    start = Clock::now();
+    for (int frame = 0; frame < frames; frame++)
+    {
+        model[3][0] = (float)frame;
+        for (int i = 0; i < objectsPerFrame; i++)
+            shader.set(modelUniform, model);
+    }
+    glFinish();
+    double handle = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+
+    std::cout << "uniform upload, " << objectsPerFrame << " mat4 per frame, " << frames << " frames" << std::endl;
+    std::cout << "  lookup: " << lookup / frames << " us/frame" << std::endl;
+    std::cout << "  cached: " << cached / frames << " us/frame" << std::endl;
+    std::cout << "  handle: " << handle / frames << " us/frame" << std::endl;
+}
+
+// World matrices of n objects written into the object buffer's texel layout, measured four ways:
+//   per-object - Transform::matrix(), i.e. transforamtion(): identity-based translate, three
+//                rotates and a scale multiplied together, then copied into the texels
+//   scalar, sse, avx - composeTransforms() over the same transforms held as a TransformBatch
+// Kernels the CPU lacks are skipped. Results are the best of a few passes, in nanoseconds
+// per object, with the largest difference from the per-object matrices.
+inline void benchmarkTransformCompose()
+{
+    typedef std::chrono::high_resolution_clock Clock;
+    const size_t counts[] = { 1000, 100000, 1000000 };
+    const size_t stride = ObjectBuffer::TEXELS_PER_OBJECT * 4;
+    srand(1);
+    for (size_t n : counts)
+    {
+        std::vector<Transform> transforms(n);
+        TransformBatch batch;
+        batch.reserve(n);
+        for (Transform& transform : transforms)
+        {
+            float values[9];
+            for (float& value : values)
+                value = rand() / (float)RAND_MAX * 2.0f - 1.0f;
+            transform = Transform(values[0] * 10, values[1] * 10, values[2] * 10, values[3] * 180, values[4] * 180, values[5] * 180,
+                1.0f + values[6], 1.0f + values[7], 1.0f + values[8]);
+            batch.add(transform);
+        }
+        std::vector<float> reference(n * stride), texels(n * stride);
+        // about a million objects per timing, so small batches are timed over many passes
+        int passes = (int)std::max<size_t>(1, 1000000 / n);
+        // nanoseconds per object, best of three timings
+        auto measure = [&](const std::function<void()>& composeAll) {
+            double best = 1e30;
+            for (int round = 0; round < 3; round++)
+            {
+                Clock::time_point start = Clock::now();
+                for (int pass = 0; pass < passes; pass++)
+                    composeAll();
+                best = std::min(best, std::chrono::duration<double, std::nano>(Clock::now() - start).count() / passes / n);
+            }
+            return best;
+        };
+
+        double perObject = measure([&]() {
+            for (size_t i = 0; i < n; i++)
+            {
+                glm::mat4 model = transforms[i].matrix();
+                for (int column = 0; column < 4; column++)
+                    for (int row = 0; row < 4; row++)
+                        reference[i * stride + column * 4 + row] = model[column][row];
+            }
+        });
+        std::cout << "transform compose, " << n << " objects" << std::endl;
+        std::cout << "  per-object: " << perObject << " ns/object" << std::endl;
+
+        for (int kernel = TRANSFORM_KERNEL_SCALAR; kernel <= bestTransformKernel(); kernel++)
+        {
+            double batched = measure([&]() { composeTransforms(batch, &texels[0], stride, (TransformKernel)kernel); });
+            float error = 0.0f;
+            for (size_t i = 0; i < n; i++)
+                for (int element = 0; element < 16; element++)
+                    error = std::max(error, std::fabs(texels[i * stride + element] - reference[i * stride + element]));
+            std::cout << "  " << transformKernelName((TransformKernel)kernel) << ": " << batched << " ns/object, "
+                << perObject / batched << "x, max error " << error << std::endl;
+        }
+    }
+}
+
+#endif
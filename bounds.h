@@ -0,0 +1,107 @@
+//
+//  bounds.h
+//  3D Object Drawing
+//
+//  Axis-aligned bounding boxes and the view frustum, for culling.
+//
+
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+#include <cfloat>
+#include <cmath>
+
+struct AABB
+{
+    glm::vec3 min;
+    glm::vec3 max;
+
+    // empty box: growing it by any point gives that point
+    AABB() : min(FLT_MAX, FLT_MAX, FLT_MAX), max(-FLT_MAX, -FLT_MAX, -FLT_MAX) {}
+    AABB(const glm::vec3& lo, const glm::vec3& hi) : min(lo), max(hi) {}
+
+    bool empty() const { return min.x > max.x; }
+
+    void grow(const glm::vec3& point)
+    {
+        min = glm::min(min, point);
+        max = glm::max(max, point);
+    }
+
+    void grow(const AABB& box)
+    {
+        min = glm::min(min, box.min);
+        max = glm::max(max, box.max);
+    }
+
+    glm::vec3 center() const { return (min + max) * 0.5f; }
+    glm::vec3 extent() const { return (max - min) * 0.5f; }
+
+    // box around the transformed box; the center moves with the matrix and the
+    // half extent goes through the absolute values of the upper 3x3
+    AABB transformed(const glm::mat4& m) const
+    {
+        if (empty())
+            return *this;
+        glm::vec3 c = center();
+        glm::vec3 e = extent();
+        glm::vec3 newCenter = glm::vec3(m * glm::vec4(c, 1.0f));
+        glm::vec3 newExtent;
+        for (int row = 0; row < 3; row++)
+            newExtent[row] = std::fabs(m[0][row]) * e.x + std::fabs(m[1][row]) * e.y + std::fabs(m[2][row]) * e.z;
+        return AABB(newCenter - newExtent, newCenter + newExtent);
+    }
+};
+
+// six planes (left, right, bottom, top, near, far) pointing inwards, taken from projection * view
+struct Frustum
+{
+    glm::vec4 planes[6];
+
+    static Frustum fromMatrix(const glm::mat4& viewProjection)
+    {
+        Frustum frustum;
+        // rows of the matrix; glm is column-major, so m[column][row]
+        glm::vec4 rows[4];
+        for (int row = 0; row < 4; row++)
+            rows[row] = glm::vec4(viewProjection[0][row], viewProjection[1][row], viewProjection[2][row], viewProjection[3][row]);
+        frustum.planes[0] = rows[3] + rows[0];
+        frustum.planes[1] = rows[3] - rows[0];
+        frustum.planes[2] = rows[3] + rows[1];
+        frustum.planes[3] = rows[3] - rows[1];
+        frustum.planes[4] = rows[3] + rows[2];
+        frustum.planes[5] = rows[3] - rows[2];
+        for (glm::vec4& plane : frustum.planes)
+            plane /= glm::length(glm::vec3(plane));
+        return frustum;
+    }
+
+    enum Result { OUTSIDE, INTERSECTS, INSIDE };
+
+    // conservative: a box near a frustum corner may be reported as intersecting
+    Result classify(const AABB& box) const
+    {
+        glm::vec3 c = box.center();
+        glm::vec3 e = box.extent();
+        Result result = INSIDE;
+        for (const glm::vec4& plane : planes)
+        {
+            float distance = plane.x * c.x + plane.y * c.y + plane.z * c.z + plane.w;
+            float radius = std::fabs(plane.x) * e.x + std::fabs(plane.y) * e.y + std::fabs(plane.z) * e.z;
+            if (distance < -radius)
+                return OUTSIDE;
+            if (distance < radius)
+                result = INTERSECTS;
+        }
+        return result;
+    }
+
+    bool intersects(const AABB& box) const
+    {
+        return classify(box) != OUTSIDE;
+    }
+};
+
+#endif
@@ -0,0 +1,208 @@
+//
+//  bvh.h
+//  3D Object Drawing
+//
+//  Bounding volume hierarchy over object boxes. Built once after loading by
+//  splitting at the median of the longest axis; when objects move (the fan)
+//  only the nodes above them are refitted, the tree shape stays the same.
+//
+
+#ifndef BVH_H
+#define BVH_H
+
+#include "bounds.h"
+
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+class BVH
+{
+public:
+    static const unsigned int LEAF_SIZE = 4;
+
+    struct Node
+    {
+        AABB bounds;
+        // children, or -1 for a leaf
+        int left, right;
+        int parent;
+        // the objects below this node are items[first, first + count)
+        unsigned int first, count;
+    };
+
+    void build(const std::vector<AABB>& boxes)
+    {
+        nodes.clear();
+        items.resize(boxes.size());
+        leafOf.assign(boxes.size(), 0);
+        marked.clear();
+        for (size_t i = 0; i < boxes.size(); i++)
+            items[i] = (unsigned int)i;
+        if (!boxes.empty())
+            buildNode(boxes, -1, 0, (unsigned int)boxes.size());
+        marked.assign(nodes.size(), 0);
+    }
+
+    // the boxes of these objects changed; recompute the nodes above them
+    void refit(const std::vector<AABB>& boxes, const std::vector<unsigned int>& objects)
+    {
+        if (nodes.empty())
+            return;
+        dirty.clear();
+        for (unsigned int object : objects)
+        {
+            for (int node = (int)leafOf[object]; node >= 0 && !marked[node]; node = nodes[node].parent)
+            {
+                marked[node] = 1;
+                dirty.push_back(node);
+            }
+        }
+        // children have higher indices than their parent, so this goes bottom-up
+        std::sort(dirty.begin(), dirty.end(), std::greater<int>());
+        for (int index : dirty)
+        {
+            Node& node = nodes[index];
+            node.bounds = AABB();
+            if (node.left < 0)
+            {
+                for (unsigned int i = node.first; i < node.first + node.count; i++)
+                    node.bounds.grow(boxes[items[i]]);
+            }
+            else
+            {
+                node.bounds.grow(nodes[node.left].bounds);
+                node.bounds.grow(nodes[node.right].bounds);
+            }
+            marked[index] = 0;
+        }
+    }
+
+    // append the objects whose box touches the frustum
+    void cull(const Frustum& frustum, const std::vector<AABB>& boxes, std::vector<unsigned int>& visible) const
+    {
+        if (!nodes.empty())
+            cull(frustum, boxes, 0, visible, stack);
+    }
+
+    // the same for the subtree below root, with the caller's stack, so several subtrees can
+    // be culled at once on different threads
+    void cull(const Frustum& frustum, const std::vector<AABB>& boxes, int root, std::vector<unsigned int>& visible, std::vector<int>& pending) const
+    {
+        pending.clear();
+        pending.push_back(root);
+        while (!pending.empty())
+        {
+            const Node& node = nodes[pending.back()];
+            pending.pop_back();
+            Frustum::Result result = frustum.classify(node.bounds);
+            if (result == Frustum::OUTSIDE)
+                continue;
+            if (result == Frustum::INSIDE)
+            {
+                // the whole subtree is visible, no more tests needed
+                visible.insert(visible.end(), items.begin() + node.first, items.begin() + node.first + node.count);
+            }
+            else if (node.left < 0)
+            {
+                for (unsigned int i = node.first; i < node.first + node.count; i++)
+                {
+                    if (frustum.intersects(boxes[items[i]]))
+                        visible.push_back(items[i]);
+                }
+            }
+            else
+            {
+                pending.push_back(node.left);
+                pending.push_back(node.right);
+            }
+        }
+    }
+
+    // the top of the tree, level by level: nodes inside or outside the frustum are settled here
+    // (visible gets the objects), partly visible ones are opened until there are at least target
+    // subtrees left, or none. roots gets the subtrees that still need cull(..., root, ...).
+    void cullTop(const Frustum& frustum, const std::vector<AABB>& boxes, size_t target, std::vector<unsigned int>& visible, std::vector<int>& roots) const
+    {
+        roots.clear();
+        if (nodes.empty())
+            return;
+        roots.push_back(0);
+        std::vector<int> next;
+        while (!roots.empty() && roots.size() < target)
+        {
+            next.clear();
+            for (int index : roots)
+            {
+                const Node& node = nodes[index];
+                Frustum::Result result = frustum.classify(node.bounds);
+                if (result == Frustum::OUTSIDE)
+                    continue;
+                if (result == Frustum::INSIDE)
+                    visible.insert(visible.end(), items.begin() + node.first, items.begin() + node.first + node.count);
+                else if (node.left < 0)
+                {
+                    for (unsigned int i = node.first; i < node.first + node.count; i++)
+                    {
+                        if (frustum.intersects(boxes[items[i]]))
+                            visible.push_back(items[i]);
+                    }
+                }
+                else
+                {
+                    next.push_back(node.left);
+                    next.push_back(node.right);
+                }
+            }
+            roots.swap(next);
+        }
+    }
+
+    const std::vector<Node>& tree() const { return nodes; }
+
+private:
+    std::vector<Node> nodes;
+    std::vector<unsigned int> items;
+    std::vector<unsigned int> leafOf;
+    std::vector<unsigned char> marked;
+    std::vector<int> dirty;
+    mutable std::vector<int> stack;
+
+    int buildNode(const std::vector<AABB>& boxes, int parent, unsigned int first, unsigned int count)
+    {
+        int index = (int)nodes.size();
+        nodes.push_back(Node());
+        AABB bounds, centers;
+        for (unsigned int i = first; i < first + count; i++)
+        {
+            bounds.grow(boxes[items[i]]);
+            centers.grow(boxes[items[i]].center());
+        }
+        nodes[index].bounds = bounds;
+        nodes[index].parent = parent;
+        nodes[index].first = first;
+        nodes[index].count = count;
+        nodes[index].left = nodes[index].right = -1;
+
+        glm::vec3 size = centers.max - centers.min;
+        int axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+        if (count <= LEAF_SIZE || size[axis] <= 0.0f)
+        {
+            for (unsigned int i = first; i < first + count; i++)
+                leafOf[items[i]] = index;
+            return index;
+        }
+
+        unsigned int half = count / 2;
+        std::nth_element(items.begin() + first, items.begin() + first + half, items.begin() + first + count,
+            [&](unsigned int a, unsigned int b) { return boxes[a].center()[axis] < boxes[b].center()[axis]; });
+        // nodes may reallocate during the recursion, so no references across it
+        int left = buildNode(boxes, index, first, half);
+        int right = buildNode(boxes, index, first + half, count - half);
+        nodes[index].left = left;
+        nodes[index].right = right;
+        return index;
+    }
+};
+
+#endif
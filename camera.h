@@ -11,6 +11,9 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "bounds.h"
 
 #include <vector>
 
@@ -38,17 +41,19 @@ const float SENSITIVITY = 0.1f;
 const float ZOOM = 45.0f;
 
 
-// An abstract camera class that processes input and calculates the corresponding Euler Angles, Vectors and Matrices for use in OpenGL
+// A camera for OpenGL. Input only accumulates, as a move along the camera's own axes and
+// turns in yaw, pitch and roll; ApplyInput() applies it in one go, with the orientation
+// rebuilt at most once, and the matrices apply it when they are first read. The orientation
+// quaternion, the view, projection and view-projection matrices and the frustum planes are
+// rebuilt once, the first time one of them is asked for after a change, and cached otherwise.
+// The world's up axis is +Y.
 class Camera
 {
 public:
     // camera Attributes
     glm::vec3 Position;
-    glm::vec3 Front;
-    glm::vec3 Up;
-    glm::vec3 Right;
-    glm::vec3 WorldUp;
-    // euler Angles
+    // euler Angles, in degrees; yaw turns about the world up axis, pitch about the camera's
+    // right axis and roll about its viewing direction
     float Yaw;
     float Pitch;
     float Roll;
@@ -58,81 +63,155 @@ public:
     float Zoom;
 
     // constructor with vectors
-    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3 up = glm::vec3(0.0f, 1.0f, 0.0f), float yaw = YAW, float pitch = PITCH) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM)
+    Camera(glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f), float yaw = YAW, float pitch = PITCH) : Position(position), Yaw(yaw), Pitch(pitch), Roll(0.0f), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM),
+        Aspect(800.0f / 600.0f), Near(0.1f), Far(100.0f), pendingMove(0.0f), pendingTurn(0.0f), pendingConstrain(false), orientationDirty(true), viewDirty(true), projectionDirty(true), viewProjectionDirty(true)
     {
-        Position = position;
-        WorldUp = up;
-        Yaw = yaw;
-        Pitch = pitch;
-        updateCameraVectors();
+        updateOrientation();
     }
     // constructor with scalar values
-    Camera(float posX, float posY, float posZ, float upX, float upY, float upZ, float yaw, float pitch) : Front(glm::vec3(0.0f, 0.0f, -1.0f)), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM)
+    Camera(float posX, float posY, float posZ, float yaw, float pitch) : Position(posX, posY, posZ), Yaw(yaw), Pitch(pitch), Roll(0.0f), MovementSpeed(SPEED), MouseSensitivity(SENSITIVITY), Zoom(ZOOM),
+        Aspect(800.0f / 600.0f), Near(0.1f), Far(100.0f), pendingMove(0.0f), pendingTurn(0.0f), pendingConstrain(false), orientationDirty(true), viewDirty(true), projectionDirty(true), viewProjectionDirty(true)
+    {
+        updateOrientation();
+    }
+
+    // perspective parameters; the field of view is Zoom
+    void SetProjection(float aspect, float nearPlane, float farPlane)
     {
-        Position = glm::vec3(posX, posY, posZ);
-        WorldUp = glm::vec3(upX, upY, upZ);
-        Yaw = yaw;
-        Pitch = pitch;
-        updateCameraVectors();
+        if (aspect == Aspect && nearPlane == Near && farPlane == Far)
+            return;
+        Aspect = aspect;
+        Near = nearPlane;
+        Far = farPlane;
+        projectionDirty = true;
     }
 
-    // returns the view matrix calculated using Euler Angles and the LookAt Matrix
-    glm::mat4 GetViewMatrix()
+    // returns the view matrix: the inverse of the camera's rotation and translation
+    const glm::mat4& GetViewMatrix()
     {
-        return glm::lookAt(Position, Position + Front, Up);
+        ApplyInput();
+        if (orientationDirty)
+            updateOrientation();
+        if (viewDirty)
+        {
+            glm::mat3 rotation = glm::transpose(glm::mat3_cast(orientation));
+            view = glm::mat4(rotation);
+            view[3] = glm::vec4(-(rotation * Position), 1.0f);
+            viewDirty = false;
+            viewProjectionDirty = true;
+        }
+        return view;
+    }
+
+    const glm::mat4& GetProjectionMatrix()
+    {
+        if (projectionDirty)
+        {
+            projection = glm::perspective(glm::radians(Zoom), Aspect, Near, Far);
+            projectionDirty = false;
+            viewProjectionDirty = true;
+        }
+        return projection;
     }
 
+    const glm::mat4& GetViewProjectionMatrix()
+    {
+        // either factor being rebuilt marks the product dirty
+        GetProjectionMatrix();
+        GetViewMatrix();
+        if (viewProjectionDirty)
+        {
+            viewProjection = projection * view;
+            frustum = Frustum::fromMatrix(viewProjection);
+            viewProjectionDirty = false;
+        }
+        return viewProjection;
+    }
+
+    // planes of the view frustum, for culling
+    const Frustum& GetFrustum()
+    {
+        GetViewProjectionMatrix();
+        return frustum;
+    }
+
+    // distance to the near clipping plane
+    float GetNear() const { return Near; }
+
+    // the camera's axes in world space
+    const glm::vec3& GetFront() { ApplyInput(); if (orientationDirty) updateOrientation(); return Front; }
+    const glm::vec3& GetRight() { ApplyInput(); if (orientationDirty) updateOrientation(); return Right; }
+    const glm::vec3& GetUp() { ApplyInput(); if (orientationDirty) updateOrientation(); return Up; }
+
     // processes input received from any keyboard-like input system. Accepts input parameter in the form of camera defined ENUM (to abstract it from windowing systems)
     void ProcessKeyboard(Camera_Movement direction, float deltaTime)
     {
         float velocity = MovementSpeed * deltaTime;
+        // along the camera's right, up and backward axes; turns in yaw, pitch and roll
         if (direction == FORWARD)
-            Position += Front * velocity;
+            pendingMove.z -= velocity;
         if (direction == BACKWARD)
-            Position -= Front * velocity;
+            pendingMove.z += velocity;
         if (direction == LEFT)
-            Position -= Right * velocity;
+            pendingMove.x -= velocity;
         if (direction == RIGHT)
-            Position += Right * velocity;
+            pendingMove.x += velocity;
         if (direction == UP)
-            Position += Up * velocity;
+            pendingMove.y += velocity;
         if (direction == DOWN)
-            Position -= Up * velocity;
+            pendingMove.y -= velocity;
         if (direction == P_UP)
-            Pitch += velocity * 10;
+            pendingTurn.y += velocity * 10;
         if (direction == P_DOWN)
-            Pitch -= velocity * 10;
+            pendingTurn.y -= velocity * 10;
         if (direction == Y_LEFT)
-            Yaw += velocity * 10;
+            pendingTurn.x += velocity * 10;
         if (direction == Y_RIGHT)
-            Yaw -= velocity * 10;
+            pendingTurn.x -= velocity * 10;
         if (direction == R_LEFT)
-            Roll += velocity * 10;
+            pendingTurn.z += velocity * 10;
         if (direction == R_RIGHT)
-            Roll -= velocity * 10;
-        updateCameraVectors();
+            pendingTurn.z -= velocity * 10;
     }
 
     // processes input received from a mouse input system. Expects the offset value in both the x and y direction.
     void ProcessMouseMovement(float xoffset, float yoffset, GLboolean constrainPitch = true)
     {
-        xoffset *= MouseSensitivity;
-        yoffset *= MouseSensitivity;
-
-        Yaw += xoffset;
-        Pitch += yoffset;
-
+        pendingTurn.x += xoffset * MouseSensitivity;
+        pendingTurn.y += yoffset * MouseSensitivity;
         // make sure that when pitch is out of bounds, screen doesn't get flipped
         if (constrainPitch)
+            pendingConstrain = true;
+    }
+
+    // applies the input collected since the last call: the move goes along the axes the camera
+    // had before it, then the turns; the orientation is rebuilt once, when it is next needed
+    void ApplyInput()
+    {
+        if (pendingMove != glm::vec3(0.0f))
+        {
+            if (orientationDirty)
+                updateOrientation();
+            Position += Right * pendingMove.x + Up * pendingMove.y - Front * pendingMove.z;
+            pendingMove = glm::vec3(0.0f);
+            viewDirty = true;
+        }
+        if (pendingTurn != glm::vec3(0.0f))
+        {
+            Yaw += pendingTurn.x;
+            Pitch += pendingTurn.y;
+            Roll += pendingTurn.z;
+            pendingTurn = glm::vec3(0.0f);
+            orientationDirty = true;
+        }
+        if (pendingConstrain)
         {
             if (Pitch > 89.0f)
                 Pitch = 89.0f;
             if (Pitch < -89.0f)
                 Pitch = -89.0f;
+            pendingConstrain = false;
         }
-
-        // update Front, Right and Up Vectors using the updated Euler angles
-        updateCameraVectors();
     }
 
     // processes input received from a mouse scroll-wheel event. Only requires input on the vertical wheel-axis
@@ -143,21 +222,60 @@ public:
             Zoom = 1.0f;
         if (Zoom > 45.0f)
             Zoom = 45.0f;
+        projectionDirty = true;
+    }
+
+    // field of view in degrees, as ProcessMouseScroll sets it
+    void SetZoom(float zoom)
+    {
+        if (zoom == Zoom)
+            return;
+        Zoom = zoom;
+        projectionDirty = true;
+    }
+
+    // places the camera directly, e.g. from a scripted path; the same pose keeps the cache
+    void SetPose(glm::vec3 position, float yaw, float pitch, float roll = 0.0f)
+    {
+        if (position != Position)
+        {
+            Position = position;
+            viewDirty = true;
+        }
+        if (yaw != Yaw || pitch != Pitch || roll != Roll)
+        {
+            Yaw = yaw;
+            Pitch = pitch;
+            Roll = roll;
+            orientationDirty = true;
+        }
     }
 
 private:
-    // calculates the front vector from the Camera's (updated) Euler Angles
-    void updateCameraVectors()
+    float Aspect, Near, Far;
+    // input not applied yet: a move in camera space (right, up, backward) and turns in
+    // degrees (yaw, pitch, roll)
+    glm::vec3 pendingMove, pendingTurn;
+    bool pendingConstrain;
+    glm::quat orientation;
+    glm::vec3 Front, Right, Up;
+    glm::mat4 view, projection, viewProjection;
+    Frustum frustum;
+    bool orientationDirty, viewDirty, projectionDirty, viewProjectionDirty;
+
+    // rotation from the euler angles, composed as quaternions so roll turns about the viewing
+    // direction whatever the yaw and pitch; yaw 0 looks along +X and yaw -90 along -Z
+    void updateOrientation()
     {
-        // calculate the new Front vector
-        glm::vec3 front;
-        front.x = cos(glm::radians(Yaw)) * cos(glm::radians(Pitch));
-        front.y = sin(glm::radians(Pitch));
-        front.z = sin(glm::radians(Yaw)) * cos(glm::radians(Pitch));
-        Front = glm::normalize(front);
-        // also re-calculate the Right and Up vector
-        Right = glm::normalize(glm::cross(Front, WorldUp));  // normalize the vectors, because their length gets closer to 0 the more you look up or down which results in slower movement.
-        Up = glm::normalize(glm::cross(Right, Front));
+        glm::quat yaw = glm::angleAxis(glm::radians(-(Yaw + 90.0f)), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::quat pitch = glm::angleAxis(glm::radians(Pitch), glm::vec3(1.0f, 0.0f, 0.0f));
+        glm::quat roll = glm::angleAxis(glm::radians(Roll), glm::vec3(0.0f, 0.0f, 1.0f));
+        orientation = glm::normalize(yaw * pitch * roll);
+        Front = orientation * glm::vec3(0.0f, 0.0f, -1.0f);
+        Right = orientation * glm::vec3(1.0f, 0.0f, 0.0f);
+        Up = orientation * glm::vec3(0.0f, 1.0f, 0.0f);
+        orientationDirty = false;
+        viewDirty = true;
     }
 };
 #endif
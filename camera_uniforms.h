@@ -0,0 +1,61 @@
+//
+//  camera_uniforms.h
+//  3D Object Drawing
+//
+//  The camera matrices in one std140 uniform buffer at CAMERA_BLOCK_BINDING.
+//  It is written once per frame and read by every program that declares
+//
+//      layout (std140) uniform Camera { mat4 view; mat4 projection; mat4 viewProjection; };
+//
+
+#ifndef CAMERA_UNIFORMS_H
+#define CAMERA_UNIFORMS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "shader.h"
+
+class CameraUniforms
+{
+public:
+    // std140: a mat4 is four vec4 columns, so the members are packed without padding
+    struct Block
+    {
+        glm::mat4 view;
+        glm::mat4 projection;
+        glm::mat4 viewProjection;
+    };
+
+    CameraUniforms() : UBO(0)
+    {
+    }
+
+    // viewProjection is projection * view, passed in as the camera already caches it
+    void update(const glm::mat4& view, const glm::mat4& projection, const glm::mat4& viewProjection)
+    {
+        Block block;
+        block.view = view;
+        block.projection = projection;
+        block.viewProjection = viewProjection;
+        if (UBO == 0)
+            glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        // orphan last frame's copy instead of waiting for draws that still read it
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(Block), &block, GL_STREAM_DRAW);
+        glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_BLOCK_BINDING, UBO);
+    }
+
+    // must run while the GL context is still current
+    void release()
+    {
+        if (UBO != 0)
+            glDeleteBuffers(1, &UBO);
+        UBO = 0;
+    }
+
+private:
+    unsigned int UBO;
+};
+
+#endif
@@ -1,7 +1,8 @@
 #ifndef fan_h
 #define fan_h
 
-#include "shader.h"
+#include "scene_file.h"
+#include "static_scene.h"
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -13,12 +14,18 @@
 class Fan {
 
 public:
-	std::vector<glm::mat4> modelMatrices;
 	float tox, toy, toz;
+	// point the blades turn around, in room coordinates
+	glm::vec3 pivot;
+	// nodes the blades hang from, one per fan instance in the loaded scene
+	std::vector<unsigned int> spinners;
+	float angle;
 	Fan(float x = 0, float y = 0, float z = 0) {
 		tox = x;
 		toy = y;
 		toz = z;
+		pivot = glm::vec3(0.0f);
+		angle = 0;
 	}
 	glm::mat4 transforamtion(float tx, float ty, float tz, float rx, float ry, float rz, float sx, float sy, float sz) {
 		tx += tox;
@@ -35,81 +42,55 @@ public:
 		return model;
 	}
 
-	Shader local_rotation(Shader ourShader, unsigned int VAOF3, float angle = 0) {
-		glm::mat4 model;
+	// define the fan as a prefab; parts are placed relative to the point the blades turn around,
+	// which is stored in pivot so the instance can be put back where the fan always was.
+	// A fan built with spinning = false has no spinner and stands still.
+	unsigned int build(SceneBuilder& builder, unsigned int cubeMesh, unsigned int holderMaterial, unsigned int rodMaterial, unsigned int bladeMaterial, bool spinning = true) {
 		float rotateAngle_X = 0;
 		float rotateAngle_Y = 0;
 		float rotateAngle_Z = 0;
-		//model = transforamtion(2.125, 2.25, -5.875, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .5, .75, .5);
-		//modelMatrices.push_back(model);
-		model = transforamtion(5, 3.5, 5, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .5, .05, 2);
-		modelMatrices.push_back(model);
-		model = transforamtion(5, 3.5, 5, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -.5, .05, -2);
-		modelMatrices.push_back(model);
-		model = transforamtion(5, 3.5, 5, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 2, .05, .5);
-		modelMatrices.push_back(model);
-		model = transforamtion(5, 3.5, 5, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -2, .05, -.5);
-		modelMatrices.push_back(model);
-
-		unsigned int vertex_array[] = { VAOF3, VAOF3, VAOF3, VAOF3 };
+		std::vector<Transform> blades;
+		//blades.push_back(Transform(2.125, 2.25, -5.875, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .5, .75, .5));
+		blades.push_back(Transform(tox + 5, toy + 3.5, toz + 5, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .5, .05, 2));
+		blades.push_back(Transform(tox + 5, toy + 3.5, toz + 5, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -.5, .05, -2));
+		blades.push_back(Transform(tox + 5, toy + 3.5, toz + 5, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 2, .05, .5));
+		blades.push_back(Transform(tox + 5, toy + 3.5, toz + 5, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -2, .05, -.5));
+
+		// the blades turn around their average position
 		glm::vec3 averagePosition(0.0f);
-		for (const glm::mat4& model : modelMatrices) {
-			averagePosition += glm::vec3(model[3]);
+		for (const Transform& blade : blades) {
+			averagePosition += blade.translation;
 		}
 
-		averagePosition /= modelMatrices.size();
-
-		glm::mat4 moveToOrigin = glm::translate(glm::mat4(1.0f), -averagePosition);
-
-		glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f));
-
-		glm::mat4 moveToOriginalPosition = glm::translate(glm::mat4(1.0f), averagePosition);
-
-		glm::mat4 groupTransform = moveToOriginalPosition * rotation * moveToOrigin;
-
-		int i = 0;
-		for (glm::mat4& model : modelMatrices) {
-
-			model = groupTransform * model;
-			ourShader.setMat4("model", model);
-			glBindVertexArray(vertex_array[i]);
-			glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-			i++;
+		averagePosition /= blades.size();
+		pivot = averagePosition;
+
+		unsigned int prefab = builder.beginPrefab("Fan");
+		Transform holder(tox + 4.95, toy + 3.45, toz + 4.85, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .6, .6, .6);
+		Transform rod(tox + 4.95, toy + 3.5, toz + 4.95, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .15, 3, .15);
+		holder.translation -= pivot;
+		rod.translation -= pivot;
+		builder.addPart(cubeMesh, holderMaterial, holder);
+		builder.addPart(cubeMesh, rodMaterial, rod);
+
+		// the file marks this group, so whoever loads the scene knows which node to turn
+		int spinnerPart = builder.addGroup(Transform(), -1, spinning ? SCENE_PART_SPIN : 0);
+		for (Transform blade : blades) {
+			blade.translation -= pivot;
+			builder.addPart(cubeMesh, bladeMaterial, blade, spinnerPart);
 		}
-		return ourShader;
+		angle = 0;
+		return prefab;
 	}
 
-	Shader ret_shader(Shader ourShader, unsigned int VAOF2, unsigned int VAOF3) {
-		glm::mat4 model;
-		float rotateAngle_X = 0;
-		float rotateAngle_Y = 0;
-		float rotateAngle_Z = 0;
-
-		//model = transforamtion(2.125, 2.25, -5.875, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .5, .75, .5);
-		//ourShader.setMat4("model", model);
-		//glBindVertexArray(VAOF2);
-		//glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-		model = transforamtion(4.5, 3.5, 5, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .5, .05, 2);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAOF3);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-		model = transforamtion(4.5, 3.5, 5, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -.5, .05, -2);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAOF3);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-		model = transforamtion(4.5, 3.5, 5, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 2, .05, .5);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAOF3);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-		model = transforamtion(4.5, 3.5, 5, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -2, .05, -.5);
-		ourShader.setMat4("model", model);
-		glBindVertexArray(VAOF3);
-		glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-		return ourShader;
+	// turn the blades of every fan in the scene; only the spinner nodes and the blades below them are marked dirty
+	void local_rotation(StaticScene& scene, float newAngle) {
+		if (newAngle == angle)
+			return;
+		angle = newAngle;
+		Pose rotation(glm::vec3(0.0f), glm::angleAxis(glm::radians(angle), glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(1.0f));
+		for (unsigned int spinner : spinners)
+			scene.setLocal(spinner, rotation);
 	}
 };
 
@@ -0,0 +1,260 @@
+//
+//  frame_benchmark.h
+//  3D Object Drawing
+//
+//  Renders a fixed number of frames along a scripted camera path and reports
+//  CPU, GPU and whole-frame times with percentiles as JSON. Runs the same way
+//  every time, so numbers from different builds can be compared.
+//
+
+#ifndef FRAME_BENCHMARK_H
+#define FRAME_BENCHMARK_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "gpu_profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct CameraKey
+{
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+    float roll;
+};
+
+// closed loop of camera poses, evenly spaced in time
+class CameraPath
+{
+public:
+    void add(const glm::vec3& position, float yaw, float pitch, float roll = 0.0f)
+    {
+        CameraKey key;
+        key.position = position;
+        key.yaw = yaw;
+        key.pitch = pitch;
+        key.roll = roll;
+        keys.push_back(key);
+    }
+
+    // t in [0, 1) covers the whole loop once
+    CameraKey sample(float t) const
+    {
+        if (keys.size() == 1)
+            return keys[0];
+        float position = (t - std::floor(t)) * keys.size();
+        size_t index = (size_t)position;
+        if (index >= keys.size())
+            index = keys.size() - 1;
+        float blend = position - index;
+        const CameraKey& a = keys[index];
+        const CameraKey& b = keys[(index + 1) % keys.size()];
+
+        // turn the short way round
+        float yawDelta = b.yaw - a.yaw;
+        yawDelta -= 360.0f * std::floor((yawDelta + 180.0f) / 360.0f);
+
+        CameraKey key;
+        key.position = a.position + (b.position - a.position) * blend;
+        key.yaw = a.yaw + yawDelta * blend;
+        key.pitch = a.pitch + (b.pitch - a.pitch) * blend;
+        key.roll = a.roll + (b.roll - a.roll) * blend;
+        return key;
+    }
+
+    size_t size() const { return keys.size(); }
+
+private:
+    std::vector<CameraKey> keys;
+};
+
+// walks along the walls looking into the room, then once under the fan looking up
+inline CameraPath bedroomFlythrough()
+{
+    CameraPath path;
+    path.add(glm::vec3(1.0f, 2.5f, 1.0f), 45.0f, -15.0f);
+    path.add(glm::vec3(5.0f, 2.0f, 1.0f), 90.0f, -10.0f);
+    path.add(glm::vec3(8.5f, 2.5f, 6.0f), 200.0f, -15.0f);
+    path.add(glm::vec3(5.0f, 2.0f, 5.0f), 270.0f, 60.0f);
+    path.add(glm::vec3(6.0f, 2.5f, 9.0f), 250.0f, -10.0f);
+    path.add(glm::vec3(1.0f, 2.5f, 9.0f), 315.0f, -15.0f);
+    return path;
+}
+
+struct FrameTimeSummary
+{
+    double mean, min, p50, p95, p99, max;
+};
+
+// nearest-rank percentile of sorted times
+inline double frameTimePercentile(const std::vector<double>& sorted, double percent)
+{
+    size_t rank = (size_t)std::ceil(percent / 100.0 * sorted.size());
+    return sorted[rank == 0 ? 0 : rank - 1];
+}
+
+// times in milliseconds
+inline FrameTimeSummary summarizeFrameTimes(std::vector<double> times)
+{
+    FrameTimeSummary summary = { 0, 0, 0, 0, 0, 0 };
+    if (times.empty())
+        return summary;
+    std::sort(times.begin(), times.end());
+    double total = 0;
+    for (double time : times)
+        total += time;
+    summary.mean = total / times.size();
+    summary.min = times.front();
+    summary.p50 = frameTimePercentile(times, 50);
+    summary.p95 = frameTimePercentile(times, 95);
+    summary.p99 = frameTimePercentile(times, 99);
+    summary.max = times.back();
+    return summary;
+}
+
+inline void writeJsonString(std::ostream& out, const char* text)
+{
+    out << '"';
+    for (const char* c = text; c != NULL && *c != '\0'; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            out << '\\' << *c;
+        else if ((unsigned char)*c >= 0x20)
+            out << *c;
+    }
+    out << '"';
+}
+
+inline void writeJsonSummary(std::ostream& out, const char* name, const FrameTimeSummary& summary)
+{
+    out << "  \"" << name << "\": { \"mean\": " << summary.mean << ", \"min\": " << summary.min
+        << ", \"p50\": " << summary.p50 << ", \"p95\": " << summary.p95 << ", \"p99\": " << summary.p99
+        << ", \"max\": " << summary.max << " }";
+}
+
+// milliseconds from launch until each milestone; assets load while frames are drawn,
+// so shaders and scene overlap and total is whichever finished last
+struct StartupTimes
+{
+    double context, firstFrame, shaders, scene, total;
+    // "hit" when every program came from the program cache, "miss" when one was compiled, "off"
+    const char* programCache;
+};
+
+// Renders warmupFrames + frames frames. Before each frame the camera is moved to the
+// path pose for that frame, then renderFrame(frame) is called; the path is covered
+// once over the measured frames.
+//   cpu_ms   - time spent in renderFrame on the CPU (command submission)
+//   gpu_ms   - GL_TIME_ELAPSED around renderFrame, read back a few frames later
+//   frame_ms - wall time from one frame start to the next
+// The GPU is allowed to run at most GPU_QUERY_LATENCY frames behind, so frame_ms
+// reflects whichever of CPU and GPU is the bottleneck. With an enabled profiler the
+// average GPU time of every section over the measured frames is added as sections_ms,
+// and with startup times given they are reported as startup_ms.
+template<typename RenderFrame>
+void runFrameBenchmark(Camera& camera, const CameraPath& path, int frames, int warmupFrames, RenderFrame renderFrame, std::ostream& json,
+    GpuProfiler* profiler = NULL, const StartupTimes* startup = NULL)
+{
+    typedef std::chrono::steady_clock Clock;
+    const int GPU_QUERY_LATENCY = 3;
+    unsigned int queries[GPU_QUERY_LATENCY + 1];
+    glGenQueries(GPU_QUERY_LATENCY + 1, queries);
+
+    std::vector<double> cpuTimes, gpuTimes, frameTimes;
+    cpuTimes.reserve(frames);
+    gpuTimes.reserve(frames);
+    frameTimes.reserve(frames);
+
+    int total = warmupFrames + frames;
+    Clock::time_point previousStart = Clock::now();
+    for (int frame = 0; frame < total + GPU_QUERY_LATENCY; frame++)
+    {
+        if (frame < total)
+        {
+            int measured = frame - warmupFrames;
+            if (measured == 0 && profiler != NULL)
+            {
+                // drop what the warm-up frames measured
+                profiler->finish();
+                profiler->resetStatistics();
+            }
+            float t = measured < 0 ? 0.0f : (float)measured / frames;
+            CameraKey key = path.sample(t);
+            camera.SetPose(key.position, key.yaw, key.pitch, key.roll);
+
+            Clock::time_point start = Clock::now();
+            if (measured > 0)
+                frameTimes.push_back(std::chrono::duration<double, std::milli>(start - previousStart).count());
+            previousStart = start;
+
+            glBeginQuery(GL_TIME_ELAPSED, queries[frame % (GPU_QUERY_LATENCY + 1)]);
+            renderFrame(frame);
+            glEndQuery(GL_TIME_ELAPSED);
+            if (measured >= 0)
+                cpuTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+            glFlush();
+        }
+
+        // the query issued GPU_QUERY_LATENCY frames ago is normally done by now
+        int resolved = frame - GPU_QUERY_LATENCY;
+        if (resolved >= 0 && resolved < total)
+        {
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(queries[resolved % (GPU_QUERY_LATENCY + 1)], GL_QUERY_RESULT, &elapsed);
+            if (resolved >= warmupFrames)
+                gpuTimes.push_back(elapsed / 1.0e6);
+        }
+    }
+    glFinish();
+    // the last frame ends when the GPU is done with it
+    if (frames > 0)
+        frameTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - previousStart).count());
+    glDeleteQueries(GPU_QUERY_LATENCY + 1, queries);
+    if (profiler != NULL)
+        profiler->finish();
+
+    json << "{\n";
+    json << "  \"frames\": " << frames << ",\n";
+    json << "  \"warmup_frames\": " << warmupFrames << ",\n";
+    json << "  \"renderer\": ";
+    writeJsonString(json, (const char*)glGetString(GL_RENDERER));
+    json << ",\n  \"version\": ";
+    writeJsonString(json, (const char*)glGetString(GL_VERSION));
+    json << ",\n";
+    if (startup != NULL)
+    {
+        json << "  \"program_cache\": ";
+        writeJsonString(json, startup->programCache);
+        json << ",\n  \"startup_ms\": { \"context\": " << startup->context << ", \"first_frame\": " << startup->firstFrame
+            << ", \"shaders\": " << startup->shaders
+            << ", \"scene\": " << startup->scene << ", \"total\": " << startup->total << " },\n";
+    }
+    writeJsonSummary(json, "cpu_ms", summarizeFrameTimes(cpuTimes));
+    json << ",\n";
+    writeJsonSummary(json, "gpu_ms", summarizeFrameTimes(gpuTimes));
+    json << ",\n";
+    writeJsonSummary(json, "frame_ms", summarizeFrameTimes(frameTimes));
+    if (profiler != NULL && profiler->isEnabled())
+    {
+        json << ",\n  \"sections_ms\": {";
+        const std::vector<GpuProfiler::Section>& sections = profiler->results();
+        for (size_t i = 0; i < sections.size(); i++)
+        {
+            json << (i == 0 ? "\n    " : ",\n    ");
+            writeJsonString(json, sections[i].name.c_str());
+            json << ": " << (sections[i].samples > 0 ? sections[i].totalMs / sections[i].samples : 0);
+        }
+        json << "\n  }";
+    }
+    json << "\n}" << std::endl;
+}
+
+#endif
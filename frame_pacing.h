@@ -0,0 +1,274 @@
+//
+//  frame_pacing.h
+//  3D Object Drawing
+//
+//  When frames start and how stale their input is.
+//    vsync       - swap interval 1, the driver may queue frames ahead
+//    uncapped    - swap interval 0, as many frames as the machine manages
+//    low-latency - swap interval 1, but the CPU waits for each frame to be
+//                  finished and then sleeps until just before the next
+//                  refresh, so input is read as late as the frame allows;
+//                  raw mouse motion is turned on
+//  LatencyMeter estimates input-to-present latency: from the poll that
+//  delivered a frame's first input to the GPU finishing that frame, read
+//  with a timestamp query issued right after the swap.
+//
+
+#ifndef FRAME_PACING_H
+#define FRAME_PACING_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "frame_benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+enum PacingMode
+{
+    PACING_VSYNC,
+    PACING_UNCAPPED,
+    PACING_LOW_LATENCY
+};
+
+// "vsync", "uncapped" or "low-latency"; false for anything else
+inline bool parsePacingMode(const char* name, PacingMode& mode)
+{
+    if (strcmp(name, "vsync") == 0)
+        mode = PACING_VSYNC;
+    else if (strcmp(name, "uncapped") == 0)
+        mode = PACING_UNCAPPED;
+    else if (strcmp(name, "low-latency") == 0)
+        mode = PACING_LOW_LATENCY;
+    else
+        return false;
+    return true;
+}
+
+class FramePacer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit FramePacer(PacingMode mode = PACING_VSYNC) : mode(mode), refreshSeconds(1.0 / 60.0), workSeconds(0.0), presented(false)
+    {
+    }
+
+    // the window's context must be current
+    void start(GLFWwindow* window)
+    {
+        glfwSwapInterval(mode == PACING_UNCAPPED ? 0 : 1);
+        GLFWmonitor* monitor = glfwGetWindowMonitor(window);
+        const GLFWvidmode* video = glfwGetVideoMode(monitor != NULL ? monitor : glfwGetPrimaryMonitor());
+        if (video != NULL && video->refreshRate > 0)
+            refreshSeconds = 1.0 / video->refreshRate;
+#ifdef GLFW_RAW_MOUSE_MOTION
+        // unaccelerated motion straight from the device, without the desktop's pointer processing
+        if (mode == PACING_LOW_LATENCY && glfwRawMouseMotionSupported())
+            glfwSetInputMode(window, GLFW_RAW_MOUSE_MOTION, GLFW_TRUE);
+#endif
+    }
+
+    PacingMode pacing() const { return mode; }
+
+    // low-latency: sleep until the latest moment the next frame can start and still make
+    // the refresh, judged by the slowest recent frame plus a margin
+    void waitForFrame()
+    {
+        if (mode == PACING_LOW_LATENCY && presented)
+        {
+            double slack = refreshSeconds - workSeconds * 1.25 - MARGIN_SECONDS;
+            if (slack > 0.0)
+            {
+                Clock::time_point wake = lastPresent + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(slack));
+                // the OS sleep overshoots, so the last millisecond is spent yielding
+                std::this_thread::sleep_until(wake - std::chrono::milliseconds(1));
+                while (Clock::now() < wake)
+                    std::this_thread::yield();
+            }
+        }
+        frameStart = Clock::now();
+    }
+
+    // read input once more just before the view matrix is built
+    bool lateLatch() const { return mode == PACING_LOW_LATENCY; }
+
+    // low-latency: wait for the GPU, so the frame's cost is known and nothing queues up behind the swap
+    void beforeSwap()
+    {
+        if (mode != PACING_LOW_LATENCY)
+            return;
+        glFinish();
+        double work = std::chrono::duration<double>(Clock::now() - frameStart).count();
+        // follow a slower frame at once, a faster one slowly
+        workSeconds = std::max(work, workSeconds * 0.95);
+    }
+
+    void afterSwap()
+    {
+        lastPresent = Clock::now();
+        presented = true;
+    }
+
+private:
+    // kept between the end of the work and the refresh
+    static constexpr double MARGIN_SECONDS = 0.001;
+
+    PacingMode mode;
+    double refreshSeconds;
+    double workSeconds;
+    bool presented;
+    Clock::time_point frameStart;
+    Clock::time_point lastPresent;
+};
+
+class LatencyMeter
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    // latency of every measured frame, milliseconds
+    std::vector<double> latencies;
+
+    LatencyMeter() : enabled(false), frame(0), inputPending(false), log(NULL), calibrated(false)
+    {
+    }
+
+    // log, when given, gets a "frame,latency_ms" line per measured frame
+    void setEnabled(bool on, std::ostream* frameLog = NULL)
+    {
+        enabled = on;
+        log = frameLog;
+        if (log != NULL)
+            *log << "frame,latency_ms\n";
+    }
+    bool isEnabled() const { return enabled; }
+
+    // input reached the application; call right after the poll that delivered it
+    void inputArrived()
+    {
+        if (enabled && !inputPending)
+        {
+            inputPending = true;
+            inputTime = Clock::now();
+        }
+    }
+
+    // call right after the swap: the timestamp query completes when the GPU is done with the frame
+    void endFrame()
+    {
+        if (!enabled)
+            return;
+        calibrate();
+        if (inputPending)
+        {
+            Pending pending;
+            pending.query = takeQuery();
+            pending.frame = frame;
+            pending.inputTime = inputTime;
+            glQueryCounter(pending.query, GL_TIMESTAMP);
+            inFlight.push_back(pending);
+            inputPending = false;
+        }
+        frame++;
+        resolve(false);
+    }
+
+    // wait for the frames still in flight
+    void finish()
+    {
+        if (enabled)
+            resolve(true);
+    }
+
+    void dump(std::ostream& out) const
+    {
+        out << "{\n  \"measured_frames\": " << latencies.size() << ",\n";
+        writeJsonSummary(out, "input_to_present_ms", summarizeFrameTimes(latencies));
+        out << "\n}" << std::endl;
+    }
+
+    // must run while the GL context is still current
+    void release()
+    {
+        finish();
+        if (!freeQueries.empty())
+            glDeleteQueries((GLsizei)freeQueries.size(), &freeQueries[0]);
+        freeQueries.clear();
+    }
+
+private:
+    struct Pending
+    {
+        GLuint query;
+        unsigned long long frame;
+        Clock::time_point inputTime;
+    };
+
+    bool enabled;
+    unsigned long long frame;
+    bool inputPending;
+    Clock::time_point inputTime;
+    std::ostream* log;
+    std::deque<Pending> inFlight;
+    std::vector<GLuint> freeQueries;
+    // GL_TIMESTAMP and steady_clock at the same moment, to move GPU times onto the CPU clock
+    bool calibrated;
+    GLint64 gpuReference;
+    Clock::time_point cpuReference;
+
+    // the two clocks drift apart, so the pair is refreshed every second
+    void calibrate()
+    {
+        Clock::time_point now = Clock::now();
+        if (calibrated && now - cpuReference < std::chrono::seconds(1))
+            return;
+        glGetInteger64v(GL_TIMESTAMP, &gpuReference);
+        cpuReference = Clock::now();
+        calibrated = true;
+    }
+
+    GLuint takeQuery()
+    {
+        GLuint query;
+        if (freeQueries.empty())
+            glGenQueries(1, &query);
+        else
+        {
+            query = freeQueries.back();
+            freeQueries.pop_back();
+        }
+        return query;
+    }
+
+    void resolve(bool wait)
+    {
+        while (!inFlight.empty())
+        {
+            const Pending& pending = inFlight.front();
+            GLint available = GL_FALSE;
+            if (!wait)
+                glGetQueryObjectiv(pending.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!wait && !available)
+                break;
+            GLuint64 done = 0;
+            glGetQueryObjectui64v(pending.query, GL_QUERY_RESULT, &done);
+            double gpuMs = ((GLint64)done - gpuReference) / 1.0e6;
+            Clock::time_point present = cpuReference + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(gpuMs));
+            double latency = std::chrono::duration<double, std::milli>(present - pending.inputTime).count();
+            latencies.push_back(latency);
+            if (log != NULL)
+                *log << pending.frame << "," << latency << "\n";
+            freeQueries.push_back(pending.query);
+            inFlight.pop_front();
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,144 @@
+//
+//  geometry_pool.h
+//  3D Object Drawing
+//
+//  All meshes of a scene packed into one vertex buffer and one index buffer
+//  behind a single VAO. A mesh is a range of the index buffer plus a base
+//  vertex, so switching meshes needs no binding and the whole scene can go
+//  out in one multi-draw call. The pool stores every vertex in one layout
+//  (vertex_format.h); with the compact one, each mesh gets the smallest
+//  index type its vertex count allows.
+//
+
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include <glad/glad.h>
+
+#include "mesh.h"
+#include "vertex_format.h"
+
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+class GeometryPool
+{
+public:
+    GeometryPool() : VAO(0), VBO(0), EBO(0), format(VERTEX_FLOAT), vertexCapacity(0), indexCapacity(0), vertexCount(0), indexBytes(0)
+    {
+    }
+
+    // the index type a mesh with that many vertices gets
+    static GLenum indexType(VertexFormat format, size_t meshVertices)
+    {
+        return format == VERTEX_COMPACT ? indexTypeFor(meshVertices) : GL_UNSIGNED_INT;
+    }
+
+    // index buffer bytes a mesh takes up, padding included
+    static size_t indexStorage(VertexFormat format, size_t meshVertices, size_t meshIndices)
+    {
+        return (meshIndices * indexSize(indexType(format, meshVertices)) + 3) & ~(size_t)3;
+    }
+
+    // allocate the buffers once for everything that will be added; indexStorage is the sum of
+    // indexStorage() over the meshes
+    void create(size_t vertices, size_t indexStorageBytes, VertexFormat vertexFormat = VERTEX_FLOAT)
+    {
+        release();
+        format = vertexFormat;
+        vertexCapacity = vertices;
+        indexCapacity = indexStorageBytes;
+        const VertexLayout& layout = vertexLayout(format);
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices * layout.stride, NULL, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexStorageBytes, NULL, GL_STATIC_DRAW);
+        applyVertexLayout(layout);
+    }
+
+    VertexFormat vertexFormat() const { return format; }
+
+    // copy one mesh into the pool; the returned mesh shares the pool's VAO and buffers.
+    // Bounds computed beforehand (e.g. on a loader thread) save a pass over the vertices.
+    // Compact positions are stored relative to quantizationBox, or the mesh's own bounds;
+    // meshes that stand in for each other (levels of detail) pass the same box.
+    Mesh add(const float* vertices, size_t verticesSize, const unsigned int* indices, size_t indicesSize, const AABB* bounds = NULL,
+        const AABB* quantizationBox = NULL)
+    {
+        Mesh mesh;
+        size_t meshVertices = verticesSize / MESH_VERTEX_SIZE;
+        size_t meshIndices = indicesSize / sizeof(unsigned int);
+        size_t storage = indexStorage(format, meshVertices, meshIndices);
+        if (vertexCount + meshVertices > vertexCapacity || indexBytes + storage > indexCapacity)
+        {
+            std::cout << "ERROR::GEOMETRY_POOL::OUT_OF_SPACE" << std::endl;
+            return mesh;
+        }
+        mesh.bounds = bounds != NULL ? *bounds : meshBounds(vertices, verticesSize);
+        mesh.dequantization = positionDequantization(format, quantizationBox != NULL ? *quantizationBox : mesh.bounds);
+        mesh.indexType = indexType(format, meshVertices);
+
+        // float vertices and 32-bit indices go up as they are; only converted ones are staged
+        const VertexLayout& layout = vertexLayout(format);
+        const void* vertexData = vertices;
+        size_t vertexBytes = meshVertices * layout.stride;
+        if (format != VERTEX_FLOAT)
+        {
+            encodeVertices(format, vertices, meshVertices, mesh.dequantization, encoded);
+            vertexData = encoded.data();
+        }
+        const void* indexData = indices;
+        size_t meshIndexBytes = meshIndices * indexSize(mesh.indexType);
+        if (mesh.indexType != GL_UNSIGNED_INT)
+        {
+            encodeIndices(mesh.indexType, indices, meshIndices, encodedIndices);
+            indexData = encodedIndices.data();
+        }
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferSubData(GL_ARRAY_BUFFER, vertexCount * layout.stride, vertexBytes, vertexData);
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, meshIndexBytes, indexData);
+
+        mesh.VAO = VAO;
+        mesh.VBO = VBO;
+        mesh.EBO = EBO;
+        mesh.indexCount = (unsigned int)meshIndices;
+        // every mesh starts on a four-byte boundary, a whole number of indices of either type
+        mesh.firstIndex = (unsigned int)(indexBytes / indexSize(mesh.indexType));
+        mesh.baseVertex = (int)vertexCount;
+        vertexCount += meshVertices;
+        indexBytes += storage;
+        return mesh;
+    }
+
+    // must run while the GL context is still current
+    void release()
+    {
+        if (VAO != 0)
+        {
+            glDeleteVertexArrays(1, &VAO);
+            glDeleteBuffers(1, &VBO);
+            glDeleteBuffers(1, &EBO);
+        }
+        VAO = VBO = EBO = 0;
+        vertexCapacity = indexCapacity = vertexCount = indexBytes = 0;
+        std::vector<unsigned char>().swap(encoded);
+        std::vector<unsigned char>().swap(encodedIndices);
+    }
+
+private:
+    unsigned int VAO, VBO, EBO;
+    VertexFormat format;
+    // vertices, and bytes of the index buffer
+    size_t vertexCapacity, indexCapacity;
+    size_t vertexCount, indexBytes;
+    // the last converted mesh in the pool's layout, reused between meshes
+    std::vector<unsigned char> encoded, encodedIndices;
+};
+
+#endif
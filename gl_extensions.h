@@ -0,0 +1,156 @@
+//
+//  gl_extensions.h
+//  3D Object Drawing
+//
+//  glad is generated for OpenGL 3.3 core, so entry points from newer versions
+//  and extensions are loaded here, with the same loader glad used. Every
+//  feature has a flag; callers check it and keep a 3.3 path when it is false.
+//
+
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <glad/glad.h>
+
+#include <cstring>
+#include <string>
+#include <unordered_set>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+// KHR_debug
+#ifndef GL_DEBUG_SOURCE_APPLICATION
+#define GL_DEBUG_SOURCE_APPLICATION 0x824A
+#endif
+
+// ARB_draw_indirect
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+// ARB_get_program_binary
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// KHR_parallel_shader_compile
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// one command of glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand
+{
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    // offsets the per-instance attributes, so every command reads its own instances
+    GLuint baseInstance;
+};
+
+struct GLExtensions
+{
+    typedef void (APIENTRY* PushDebugGroupProc)(GLenum source, GLuint id, GLsizei length, const GLchar* message);
+    typedef void (APIENTRY* PopDebugGroupProc)();
+    typedef void (APIENTRY* ObjectLabelProc)(GLenum identifier, GLuint name, GLsizei length, const GLchar* label);
+    typedef void (APIENTRY* MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride);
+    typedef void (APIENTRY* GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+    typedef void (APIENTRY* ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+    typedef void (APIENTRY* ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+    typedef void (APIENTRY* MaxShaderCompilerThreadsProc)(GLuint count);
+
+    // KHR_debug (core in 4.3): debug groups and object labels show up in apitrace and RenderDoc
+    bool debug;
+    PushDebugGroupProc pushDebugGroup;
+    PopDebugGroupProc popDebugGroup;
+    ObjectLabelProc objectLabel;
+    // ARB_multi_draw_indirect with a honoured baseInstance (core in 4.3)
+    bool multiDrawIndirect;
+    MultiDrawElementsIndirectProc multiDrawElementsIndirect;
+    // ARB_get_program_binary (core in 4.1), and the driver offers at least one binary format
+    bool programBinary;
+    GetProgramBinaryProc getProgramBinary;
+    ProgramBinaryProc loadProgramBinary;
+    ProgramParameteriProc programParameteri;
+    // KHR_parallel_shader_compile (or the ARB one): compiles run on driver threads and
+    // GL_COMPLETION_STATUS_KHR tells whether a program is done without waiting for it
+    bool parallelShaderCompile;
+    MaxShaderCompilerThreadsProc maxShaderCompilerThreads;
+
+    GLExtensions() : debug(false), pushDebugGroup(NULL), popDebugGroup(NULL), objectLabel(NULL),
+        multiDrawIndirect(false), multiDrawElementsIndirect(NULL),
+        programBinary(false), getProgramBinary(NULL), loadProgramBinary(NULL), programParameteri(NULL),
+        parallelShaderCompile(false), maxShaderCompilerThreads(NULL), major(0), minor(0)
+    {
+    }
+
+    // call once after gladLoadGLLoader, with the same loader
+    void load(GLADloadproc loader)
+    {
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+            extensions.insert((const char*)glGetStringi(GL_EXTENSIONS, i));
+
+        if (version(4, 3) || has("GL_KHR_debug"))
+        {
+            pushDebugGroup = (PushDebugGroupProc)loader("glPushDebugGroup");
+            popDebugGroup = (PopDebugGroupProc)loader("glPopDebugGroup");
+            objectLabel = (ObjectLabelProc)loader("glObjectLabel");
+            debug = pushDebugGroup != NULL && popDebugGroup != NULL && objectLabel != NULL;
+        }
+        if (version(4, 3) || (has("GL_ARB_multi_draw_indirect") && (version(4, 2) || has("GL_ARB_base_instance"))))
+        {
+            multiDrawElementsIndirect = (MultiDrawElementsIndirectProc)loader("glMultiDrawElementsIndirect");
+            multiDrawIndirect = multiDrawElementsIndirect != NULL;
+        }
+        if (version(4, 1) || has("GL_ARB_get_program_binary"))
+        {
+            GLint formats = 0;
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+            getProgramBinary = (GetProgramBinaryProc)loader("glGetProgramBinary");
+            loadProgramBinary = (ProgramBinaryProc)loader("glProgramBinary");
+            programParameteri = (ProgramParameteriProc)loader("glProgramParameteri");
+            programBinary = formats > 0 && getProgramBinary != NULL && loadProgramBinary != NULL && programParameteri != NULL;
+        }
+        if (has("GL_KHR_parallel_shader_compile"))
+            maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)loader("glMaxShaderCompilerThreadsKHR");
+        else if (has("GL_ARB_parallel_shader_compile"))
+            maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)loader("glMaxShaderCompilerThreadsARB");
+        parallelShaderCompile = maxShaderCompilerThreads != NULL;
+    }
+
+    bool has(const char* extension) const
+    {
+        return extensions.count(extension) != 0;
+    }
+
+    bool version(int wantMajor, int wantMinor) const
+    {
+        return major > wantMajor || (major == wantMajor && minor >= wantMinor);
+    }
+
+private:
+    GLint major, minor;
+    std::unordered_set<std::string> extensions;
+};
+
+// the entry points belong to the one context the application creates
+inline GLExtensions& glExtensions()
+{
+    static GLExtensions extensions;
+    return extensions;
+}
+
+#endif
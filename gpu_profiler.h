@@ -0,0 +1,208 @@
+//
+//  gpu_profiler.h
+//  3D Object Drawing
+//
+//  Per-section GPU times. Each section is bracketed by a pair of timestamp
+//  queries and a KHR_debug group, so it is both measured and readable in
+//  apitrace/RenderDoc captures. Results are read one frame or more later,
+//  only once they are available, so the CPU never waits for the GPU.
+//
+
+#ifndef GPU_PROFILER_H
+#define GPU_PROFILER_H
+
+#include <glad/glad.h>
+
+#include "gl_extensions.h"
+
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class GpuProfiler
+{
+public:
+    struct Section
+    {
+        std::string name;
+        double lastMs;
+        double totalMs;
+        unsigned int samples;
+    };
+
+    GpuProfiler() : enabled(false), frame(0), open(-1)
+    {
+    }
+
+    void setEnabled(bool on) { enabled = on; }
+    bool isEnabled() const { return enabled; }
+
+    // collect every result that has arrived since the last frame
+    void beginFrame()
+    {
+        if (!enabled)
+            return;
+        frame++;
+        size_t kept = 0;
+        for (size_t i = 0; i < pending.size(); i++)
+        {
+            Pending& query = pending[i];
+            GLint available = 0;
+            if (query.frame < frame)
+                glGetQueryObjectiv(query.end, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available)
+                resolve(query);
+            else
+                pending[kept++] = query;
+        }
+        pending.resize(kept);
+    }
+
+    // sections must not overlap; a name seen before adds to the same statistics
+    void begin(const char* name)
+    {
+        if (!enabled)
+            return;
+        GLExtensions& ext = glExtensions();
+        if (ext.debug)
+            ext.pushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+
+        Pending query;
+        query.section = sectionIndex(name);
+        query.frame = frame;
+        query.begin = acquire();
+        query.end = acquire();
+        glQueryCounter(query.begin, GL_TIMESTAMP);
+        pending.push_back(query);
+        open = (int)pending.size() - 1;
+    }
+
+    void end()
+    {
+        if (!enabled || open < 0)
+            return;
+        glQueryCounter(pending[open].end, GL_TIMESTAMP);
+        open = -1;
+        GLExtensions& ext = glExtensions();
+        if (ext.debug)
+            ext.popDebugGroup();
+    }
+
+    // wait for everything in flight; use before reading the final numbers
+    void finish()
+    {
+        for (Pending& query : pending)
+            resolve(query);
+        pending.clear();
+    }
+
+    // forget the statistics gathered so far, e.g. after warm-up frames
+    void resetStatistics()
+    {
+        for (Section& section : sections)
+        {
+            section.lastMs = section.totalMs = 0;
+            section.samples = 0;
+        }
+    }
+
+    const std::vector<Section>& results() const { return sections; }
+
+    // average over all samples, or -1 if the section was never measured
+    double averageMs(const std::string& name) const
+    {
+        std::unordered_map<std::string, unsigned int>::const_iterator it = sectionIndices.find(name);
+        if (it == sectionIndices.end() || sections[it->second].samples == 0)
+            return -1;
+        return sections[it->second].totalMs / sections[it->second].samples;
+    }
+
+    void dump(std::ostream& out) const
+    {
+        out << "GPU time per section (ms)" << std::endl;
+        out << std::left << std::setw(16) << "section" << std::right << std::setw(10) << "average" << std::setw(10) << "last" << std::setw(10) << "samples" << std::endl;
+        for (const Section& section : sections)
+        {
+            double average = section.samples > 0 ? section.totalMs / section.samples : 0;
+            out << std::left << std::setw(16) << section.name << std::right << std::fixed << std::setprecision(4)
+                << std::setw(10) << average << std::setw(10) << section.lastMs << std::setw(10) << section.samples << std::endl;
+        }
+        out.unsetf(std::ios::fixed);
+    }
+
+    // free the queries; must run while the GL context is still current
+    void release()
+    {
+        for (Pending& query : pending)
+        {
+            freeQueries.push_back(query.begin);
+            freeQueries.push_back(query.end);
+        }
+        pending.clear();
+        if (!freeQueries.empty())
+            glDeleteQueries((GLsizei)freeQueries.size(), freeQueries.data());
+        freeQueries.clear();
+    }
+
+private:
+    struct Pending
+    {
+        unsigned int section;
+        unsigned int frame;
+        GLuint begin, end;
+    };
+
+    bool enabled;
+    unsigned int frame;
+    int open;
+    std::vector<Section> sections;
+    std::unordered_map<std::string, unsigned int> sectionIndices;
+    std::vector<Pending> pending;
+    // queries are recycled, so after the first frames no new ones are created
+    std::vector<GLuint> freeQueries;
+
+    unsigned int sectionIndex(const char* name)
+    {
+        std::unordered_map<std::string, unsigned int>::iterator it = sectionIndices.find(name);
+        if (it != sectionIndices.end())
+            return it->second;
+        Section section;
+        section.name = name;
+        section.lastMs = section.totalMs = 0;
+        section.samples = 0;
+        sections.push_back(section);
+        unsigned int index = (unsigned int)sections.size() - 1;
+        sectionIndices[name] = index;
+        return index;
+    }
+
+    GLuint acquire()
+    {
+        if (freeQueries.empty())
+        {
+            GLuint query;
+            glGenQueries(1, &query);
+            return query;
+        }
+        GLuint query = freeQueries.back();
+        freeQueries.pop_back();
+        return query;
+    }
+
+    void resolve(const Pending& query)
+    {
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(query.begin, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(query.end, GL_QUERY_RESULT, &end);
+        Section& section = sections[query.section];
+        section.lastMs = (end - begin) / 1.0e6;
+        section.totalMs += section.lastMs;
+        section.samples++;
+        freeQueries.push_back(query.begin);
+        freeQueries.push_back(query.end);
+    }
+};
+
+#endif
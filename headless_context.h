@@ -0,0 +1,262 @@
+//
+//  headless_context.h
+//  3D Object Drawing
+//
+//  An OpenGL 3.3 core context without a window, for running the renderer on
+//  build machines that have no display and no GPU (Mesa llvmpipe works).
+//    Linux/BSD   - EGL with the surfaceless platform (link with -lEGL)
+//    BEDROOM_OSMESA defined - OSMesa rendering into client memory (link with -lOSMesa)
+//    Windows     - a hidden GLFW window, since EGL is normally not available
+//  There is no default framebuffer in the surfaceless case, so frames are
+//  rendered into an offscreen framebuffer object of the requested size.
+//
+
+#ifndef HEADLESS_CONTEXT_H
+#define HEADLESS_CONTEXT_H
+
+#include <glad/glad.h>
+
+#include "gl_extensions.h"
+
+#if defined(BEDROOM_OSMESA)
+#include <GL/osmesa.h>
+#elif defined(_WIN32)
+#include <GLFW/glfw3.h>
+#else
+#define EGL_NO_X11
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <iostream>
+#include <vector>
+
+class HeadlessContext
+{
+public:
+    HeadlessContext() : framebuffer(0), colorBuffer(0), depthBuffer(0), width(0), height(0)
+    {
+#if defined(BEDROOM_OSMESA)
+        context = NULL;
+#elif defined(_WIN32)
+        window = NULL;
+#else
+        display = EGL_NO_DISPLAY;
+        context = EGL_NO_CONTEXT;
+#endif
+    }
+
+    ~HeadlessContext()
+    {
+        destroy();
+    }
+
+    // create the context, make it current and load the GL entry points, including glExtensions()
+    bool create(int w, int h)
+    {
+        width = w;
+        height = h;
+        if (!createContext())
+            return false;
+        if (!gladLoadGLLoader(getProcAddress))
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            destroy();
+            return false;
+        }
+        glExtensions().load(getProcAddress);
+        return createFramebuffer();
+    }
+
+    void destroy()
+    {
+        if (framebuffer != 0)
+        {
+            glDeleteFramebuffers(1, &framebuffer);
+            glDeleteRenderbuffers(1, &colorBuffer);
+            glDeleteRenderbuffers(1, &depthBuffer);
+            framebuffer = colorBuffer = depthBuffer = 0;
+        }
+#if defined(BEDROOM_OSMESA)
+        if (context != NULL)
+            OSMesaDestroyContext(context);
+        context = NULL;
+#elif defined(_WIN32)
+        if (window != NULL)
+        {
+            glfwDestroyWindow(window);
+            glfwTerminate();
+        }
+        window = NULL;
+#else
+        if (context != EGL_NO_CONTEXT)
+        {
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            eglDestroyContext(display, context);
+        }
+        if (display != EGL_NO_DISPLAY)
+            eglTerminate(display);
+        context = EGL_NO_CONTEXT;
+        display = EGL_NO_DISPLAY;
+#endif
+    }
+
+    // the offscreen framebuffer stays bound; rebind it if something else was bound in between
+    void bindFramebuffer() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glViewport(0, 0, width, height);
+    }
+
+private:
+    unsigned int framebuffer, colorBuffer, depthBuffer;
+    int width, height;
+#if defined(BEDROOM_OSMESA)
+    OSMesaContext context;
+    std::vector<unsigned char> pixels;
+#elif defined(_WIN32)
+    GLFWwindow* window;
+#else
+    EGLDisplay display;
+    EGLContext context;
+#endif
+
+    HeadlessContext(const HeadlessContext&);
+    HeadlessContext& operator=(const HeadlessContext&);
+
+#if defined(BEDROOM_OSMESA)
+    static void* getProcAddress(const char* name)
+    {
+        return (void*)OSMesaGetProcAddress(name);
+    }
+
+    bool createContext()
+    {
+        const int attributes[] = {
+            OSMESA_FORMAT, OSMESA_RGBA,
+            OSMESA_DEPTH_BITS, 24,
+            OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+            OSMESA_CONTEXT_MAJOR_VERSION, 3,
+            OSMESA_CONTEXT_MINOR_VERSION, 3,
+            0
+        };
+        context = OSMesaCreateContextAttribs(attributes, NULL);
+        if (context == NULL)
+        {
+            std::cout << "ERROR::HEADLESS::OSMESA_CONTEXT_CREATION_FAILED" << std::endl;
+            return false;
+        }
+        pixels.resize((size_t)width * height * 4);
+        if (!OSMesaMakeCurrent(context, pixels.data(), GL_UNSIGNED_BYTE, width, height))
+        {
+            std::cout << "ERROR::HEADLESS::OSMESA_MAKE_CURRENT_FAILED" << std::endl;
+            destroy();
+            return false;
+        }
+        return true;
+    }
+#elif defined(_WIN32)
+    static void* getProcAddress(const char* name)
+    {
+        return (void*)glfwGetProcAddress(name);
+    }
+
+    bool createContext()
+    {
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        window = glfwCreateWindow(width, height, "benchmark", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "ERROR::HEADLESS::WINDOW_CREATION_FAILED" << std::endl;
+            glfwTerminate();
+            return false;
+        }
+        glfwMakeContextCurrent(window);
+        // never wait for vertical blank; frames are not presented anyway
+        glfwSwapInterval(0);
+        return true;
+    }
+#else
+    static void* getProcAddress(const char* name)
+    {
+        return (void*)eglGetProcAddress(name);
+    }
+
+    bool createContext()
+    {
+        // prefer the surfaceless platform so no X11 or Wayland connection is needed
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay != NULL)
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+        if (display == EGL_NO_DISPLAY)
+            display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        EGLint major, minor;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+        {
+            std::cout << "ERROR::HEADLESS::EGL_INITIALIZE_FAILED" << std::endl;
+            display = EGL_NO_DISPLAY;
+            return false;
+        }
+
+        // the surface type defaults to window, which the surfaceless platform has none of
+        const EGLint configAttributes[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE
+        };
+        EGLConfig config;
+        EGLint configCount = 0;
+        if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0 || !eglBindAPI(EGL_OPENGL_API))
+        {
+            std::cout << "ERROR::HEADLESS::EGL_NO_OPENGL_CONFIG" << std::endl;
+            destroy();
+            return false;
+        }
+
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+            EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+        // EGL_KHR_surfaceless_context: current without any surface
+        if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+        {
+            std::cout << "ERROR::HEADLESS::EGL_CONTEXT_CREATION_FAILED" << std::endl;
+            destroy();
+            return false;
+        }
+        return true;
+    }
+#endif
+
+    bool createFramebuffer()
+    {
+        glGenRenderbuffers(1, &colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "ERROR::HEADLESS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+            destroy();
+            return false;
+        }
+        glViewport(0, 0, width, height);
+        return true;
+    }
+};
+
+#endif
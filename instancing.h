@@ -0,0 +1,259 @@
+//
+//  instancing.h
+//  3D Object Drawing
+//
+//  Collects the index of every object that shares a mesh and draws each group
+//  with a single glDrawElementsInstanced call. The shader looks the index up
+//  in the object buffer (object_buffer.h) for the model matrix and color, so
+//  an instance is four bytes instead of a matrix and a color. When
+//  the meshes share a VAO (geometry_pool.h) and multi-draw indirect is
+//  available, all groups go out in one glMultiDrawElementsIndirect call; each
+//  command's baseInstance points it at its own slice of the instance buffer.
+//  Objects queued with append() are drawn in the order they came in, e.g.
+//  sorted by a render queue (render_queue.h).
+//
+
+#ifndef INSTANCING_H
+#define INSTANCING_H
+
+#include <glad/glad.h>
+
+#include "gl_extensions.h"
+#include "mesh.h"
+#include "shader.h"
+
+#include <vector>
+
+class InstanceBatch
+{
+public:
+    // attribute location of the per-instance object index
+    static const GLuint OBJECT_ATTRIBUTE = 2;
+
+    // index of the object in the object buffer
+    typedef GLuint Instance;
+
+    InstanceBatch() : instanceVBO(0), indirectBuffer(0), capacity(0), multiDraw(true), lastDrawCalls(0), lastInstances(0)
+    {
+    }
+
+    // free the instance and command buffers; must run while the GL context is still current
+    void release()
+    {
+        if (instanceVBO != 0)
+            glDeleteBuffers(1, &instanceVBO);
+        if (indirectBuffer != 0)
+            glDeleteBuffers(1, &indirectBuffer);
+        instanceVBO = indirectBuffer = 0;
+        capacity = 0;
+    }
+
+    // use glMultiDrawElementsIndirect when the context has it
+    void setMultiDraw(bool on) { multiDraw = on; }
+
+    // queue one object; objects with the same mesh end up in the same draw
+    void add(const Mesh& mesh, unsigned int object)
+    {
+        Instance instance = object;
+        for (Group& group : groups)
+        {
+            if (group.matches(mesh))
+            {
+                group.instances.push_back(instance);
+                return;
+            }
+        }
+        startGroup(mesh, instance);
+    }
+
+    // queue one object after everything queued so far: it only joins the last group, so the
+    // draws keep the order of the calls. Consecutive objects with the same mesh share a draw.
+    void append(const Mesh& mesh, unsigned int object)
+    {
+        if (!groups.empty() && groups.back().matches(mesh))
+            groups.back().instances.push_back(object);
+        else
+            startGroup(mesh, object);
+    }
+
+    // upload every queued instance into the instance buffer and draw all groups; instanced is
+    // the program's switch to the per-instance object index
+    void flush(const Shader& shader, Uniform<bool> instanced)
+    {
+        size_t total = 0;
+        for (const Group& group : groups)
+            total += group.instances.size();
+
+        lastDrawCalls = 0;
+        lastInstances = (unsigned int)total;
+        if (total == 0)
+        {
+            recycleGroups();
+            return;
+        }
+
+        if (instanceVBO == 0)
+            glGenBuffers(1, &instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        if (total > capacity)
+            capacity = total;
+        // orphan the previous frame's storage so the driver never has to wait on it
+        glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(Instance), NULL, GL_STREAM_DRAW);
+
+        size_t offset = 0;
+        for (const Group& group : groups)
+        {
+            if (group.instances.empty())
+                continue;
+            glBufferSubData(GL_ARRAY_BUFFER, offset * sizeof(Instance), group.instances.size() * sizeof(Instance), &group.instances[0]);
+            offset += group.instances.size();
+        }
+
+        shader.set(instanced, true);
+        if (multiDraw && glExtensions().multiDrawIndirect)
+            drawIndirect();
+        else
+            drawGroups();
+        shader.set(instanced, false);
+        recycleGroups();
+    }
+
+    // statistics of the last flush
+    unsigned int drawCalls() const { return lastDrawCalls; }
+    unsigned int instances() const { return lastInstances; }
+
+private:
+    struct Group
+    {
+        unsigned int VAO;
+        unsigned int indexCount;
+        unsigned int firstIndex;
+        int baseVertex;
+        GLenum indexType;
+        std::vector<Instance> instances;
+
+        bool matches(const Mesh& mesh) const
+        {
+            return VAO == mesh.VAO && firstIndex == mesh.firstIndex && baseVertex == mesh.baseVertex && indexCount == mesh.indexCount && indexType == mesh.indexType;
+        }
+    };
+
+    std::vector<Group> groups;
+    // instance lists of flushed groups, kept to be reused with their allocations
+    std::vector<std::vector<Instance> > spareInstances;
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<unsigned int> commandVAOs;
+    std::vector<GLenum> commandIndexTypes;
+    unsigned int instanceVBO;
+    unsigned int indirectBuffer;
+    size_t capacity;
+    bool multiDraw;
+    unsigned int lastDrawCalls;
+    unsigned int lastInstances;
+
+    void startGroup(const Mesh& mesh, Instance instance)
+    {
+        groups.push_back(Group());
+        Group& group = groups.back();
+        group.VAO = mesh.VAO;
+        group.indexCount = mesh.indexCount;
+        group.firstIndex = mesh.firstIndex;
+        group.baseVertex = mesh.baseVertex;
+        group.indexType = mesh.indexType;
+        if (!spareInstances.empty())
+        {
+            group.instances.swap(spareInstances.back());
+            spareInstances.pop_back();
+        }
+        group.instances.push_back(instance);
+    }
+
+    // empty the queue but keep the allocations around for the next frame
+    void recycleGroups()
+    {
+        for (Group& group : groups)
+        {
+            group.instances.clear();
+            spareInstances.push_back(std::vector<Instance>());
+            spareInstances.back().swap(group.instances);
+        }
+        groups.clear();
+    }
+
+    // one instanced draw per group; the instance attributes are re-pointed at the group's slice,
+    // the VAO only rebound when it changes
+    void drawGroups()
+    {
+        size_t offset = 0;
+        unsigned int boundVAO = 0xFFFFFFFFu;
+        for (const Group& group : groups)
+        {
+            if (group.instances.empty())
+                continue;
+            if (group.VAO != boundVAO)
+            {
+                glBindVertexArray(group.VAO);
+                boundVAO = group.VAO;
+            }
+            bindInstanceAttributes(offset * sizeof(Instance));
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, group.indexCount, group.indexType, (void*)(group.firstIndex * indexSize(group.indexType)),
+                (GLsizei)group.instances.size(), group.baseVertex);
+            lastDrawCalls++;
+            offset += group.instances.size();
+        }
+    }
+
+    // one command per group, one multi-draw per run of groups sharing a VAO and index type (a single one for a pooled scene
+    // whose meshes all have 16-bit indices)
+    void drawIndirect()
+    {
+        commands.clear();
+        commandVAOs.clear();
+        commandIndexTypes.clear();
+        GLuint baseInstance = 0;
+        for (const Group& group : groups)
+        {
+            if (group.instances.empty())
+                continue;
+            DrawElementsIndirectCommand command;
+            command.count = group.indexCount;
+            command.instanceCount = (GLuint)group.instances.size();
+            command.firstIndex = group.firstIndex;
+            command.baseVertex = group.baseVertex;
+            command.baseInstance = baseInstance;
+            commands.push_back(command);
+            commandVAOs.push_back(group.VAO);
+            commandIndexTypes.push_back(group.indexType);
+            baseInstance += command.instanceCount;
+        }
+
+        if (indirectBuffer == 0)
+            glGenBuffers(1, &indirectBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), &commands[0], GL_STREAM_DRAW);
+
+        size_t first = 0;
+        while (first < commands.size())
+        {
+            size_t end = first + 1;
+            while (end < commands.size() && commandVAOs[end] == commandVAOs[first] && commandIndexTypes[end] == commandIndexTypes[first])
+                end++;
+            glBindVertexArray(commandVAOs[first]);
+            bindInstanceAttributes(0);
+            glExtensions().multiDrawElementsIndirect(GL_TRIANGLES, commandIndexTypes[first], (void*)(first * sizeof(DrawElementsIndirectCommand)), (GLsizei)(end - first), 0);
+            lastDrawCalls++;
+            first = end;
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    }
+
+    // point the bound VAO's per-instance object index at the instance buffer; an integer attribute, so no conversion to float
+    void bindInstanceAttributes(size_t byteOffset)
+    {
+        glVertexAttribIPointer(OBJECT_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(Instance), (void*)byteOffset);
+        glEnableVertexAttribArray(OBJECT_ATTRIBUTE);
+        glVertexAttribDivisor(OBJECT_ATTRIBUTE, 1);
+    }
+};
+
+#endif
@@ -0,0 +1,291 @@
+//
+//  job_system.h
+//  3D Object Drawing
+//
+//  Work-stealing scheduler for the CPU work of a frame. One thread per core:
+//  the thread that owns the GL context plus workers. Every thread keeps its
+//  own queue, takes its newest job first and, when the queue runs dry,
+//  steals the oldest job of another thread. A job can wait on other jobs
+//  (addDependency) and can split itself into children (parallelFor); it is
+//  finished when its children are. A thread that waits runs other jobs
+//  meanwhile, and idle workers sleep instead of spinning.
+//
+
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class JobSystem
+{
+public:
+    struct Job
+    {
+        std::function<void()> work;
+        // the job itself plus its children that have not finished
+        std::atomic<int> unfinished;
+        // submit() plus the dependencies that have not finished; the job is queued at zero
+        std::atomic<int> blockers;
+        Job* parent;
+        // jobs that wait for this one; guarded by lock together with finished
+        std::vector<Job*> continuations;
+        bool finished;
+        std::mutex lock;
+        // set last, once nothing touches the job any more
+        std::atomic<bool> done;
+
+        Job() : unfinished(1), blockers(1), parent(NULL), finished(false), done(false)
+        {
+        }
+    };
+
+    // threads = 0 uses one thread per core; the calling thread counts as one of them
+    explicit JobSystem(unsigned int threads = 0) : stopping(false), queued(0), sleeping(0), live(0)
+    {
+        if (threads == 0)
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned int i = 0; i < threads; i++)
+            queues.push_back(std::unique_ptr<Queue>(new Queue()));
+        threadIndex() = 0;
+        for (unsigned int i = 1; i < threads; i++)
+            workers.push_back(std::thread(&JobSystem::work, this, i));
+    }
+
+    ~JobSystem()
+    {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers)
+            worker.join();
+    }
+
+    unsigned int threadCount() const { return (unsigned int)queues.size(); }
+
+    // a job that runs work() once submitted; with a parent, the parent is not finished before it.
+    // Jobs stay allocated until reset().
+    Job* create(std::function<void()> work, Job* parent = NULL)
+    {
+        Queue& queue = *queues[threadIndex()];
+        Job* job;
+        {
+            std::lock_guard<std::mutex> lock(queue.lock);
+            queue.arena.emplace_back();
+            job = &queue.arena.back();
+        }
+        job->work = std::move(work);
+        job->parent = parent;
+        if (parent != NULL)
+            parent->unfinished++;
+        return job;
+    }
+
+    // job does not start before dependency is finished; call before submit(job)
+    void addDependency(Job* job, Job* dependency)
+    {
+        job->blockers++;
+        std::lock_guard<std::mutex> lock(dependency->lock);
+        if (dependency->finished)
+            job->blockers--;
+        else
+            dependency->continuations.push_back(job);
+    }
+
+    // the job runs as soon as its dependencies are finished
+    void submit(Job* job)
+    {
+        live++;
+        if (--job->blockers == 0)
+            push(job);
+    }
+
+    // returns once the job and its children are finished; runs other jobs meanwhile
+    void wait(const Job* job)
+    {
+        while (!job->done)
+        {
+            if (!runOne())
+                std::this_thread::yield();
+        }
+    }
+
+    // body(first, end) over [0, count) in pieces of about grain items, spread over the threads;
+    // returns when every piece is done
+    void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body)
+    {
+        grain = std::max<size_t>(grain, 1);
+        if (queues.size() == 1 || count <= grain)
+        {
+            if (count > 0)
+                body(0, count);
+            return;
+        }
+        Job* all = create(std::function<void()>());
+        for (size_t first = 0; first < count; first += grain)
+        {
+            size_t end = std::min(count, first + grain);
+            submit(create([&body, first, end]() { body(first, end); }, all));
+        }
+        submit(all);
+        wait(all);
+    }
+
+    // pieces of about count / (threads * piecesPerThread) items, at least minimum
+    size_t grainFor(size_t count, size_t minimum, size_t piecesPerThread = 4) const
+    {
+        return std::max(minimum, count / (queues.size() * piecesPerThread) + 1);
+    }
+
+    // forget every job; waits for jobs that are still finishing. Call from the context thread
+    // between frames, when nobody holds a Job pointer any more.
+    void reset()
+    {
+        while (live > 0)
+        {
+            if (!runOne())
+                std::this_thread::yield();
+        }
+        for (std::unique_ptr<Queue>& queue : queues)
+        {
+            std::lock_guard<std::mutex> lock(queue->lock);
+            queue->arena.clear();
+        }
+    }
+
+private:
+    struct Queue
+    {
+        // guards both
+        std::mutex lock;
+        std::deque<Job*> jobs;
+        // the jobs this thread created; a deque never moves its elements
+        std::deque<Job> arena;
+    };
+
+    std::vector<std::unique_ptr<Queue> > queues;
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping;
+    // jobs waiting in some queue, workers asleep, jobs submitted and not yet done
+    std::atomic<int> queued;
+    std::atomic<int> sleeping;
+    std::atomic<int> live;
+
+    // queue of the calling thread; threads the system did not start share the first one
+    static unsigned int& threadIndex()
+    {
+        static thread_local unsigned int index = 0;
+        return index;
+    }
+
+    void push(Job* job)
+    {
+        Queue& queue = *queues[threadIndex()];
+        {
+            std::lock_guard<std::mutex> lock(queue.lock);
+            queue.jobs.push_back(job);
+        }
+        queued++;
+        if (sleeping > 0)
+        {
+            // taking the lock orders this with a worker between checking queued and sleeping
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            wake.notify_one();
+        }
+    }
+
+    // own newest job first, it is likely still in this core's cache; then the oldest job of
+    // another thread, which tends to be the biggest piece left
+    Job* take()
+    {
+        unsigned int self = threadIndex();
+        {
+            Queue& queue = *queues[self];
+            std::lock_guard<std::mutex> lock(queue.lock);
+            if (!queue.jobs.empty())
+            {
+                Job* job = queue.jobs.back();
+                queue.jobs.pop_back();
+                queued--;
+                return job;
+            }
+        }
+        for (size_t i = 1; i < queues.size(); i++)
+        {
+            Queue& victim = *queues[(self + i) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.lock);
+            if (!victim.jobs.empty())
+            {
+                Job* job = victim.jobs.front();
+                victim.jobs.pop_front();
+                queued--;
+                return job;
+            }
+        }
+        return NULL;
+    }
+
+    bool runOne()
+    {
+        if (queued == 0)
+            return false;
+        Job* job = take();
+        if (job == NULL)
+            return false;
+        if (job->work)
+            job->work();
+        finish(job);
+        return true;
+    }
+
+    void finish(Job* job)
+    {
+        if (--job->unfinished > 0)
+            return;
+        std::vector<Job*> ready;
+        {
+            std::lock_guard<std::mutex> lock(job->lock);
+            job->finished = true;
+            ready.swap(job->continuations);
+        }
+        for (Job* next : ready)
+        {
+            if (--next->blockers == 0)
+                push(next);
+        }
+        Job* parent = job->parent;
+        job->done = true;
+        live--;
+        if (parent != NULL)
+            finish(parent);
+    }
+
+    void work(unsigned int index)
+    {
+        threadIndex() = index;
+        for (;;)
+        {
+            if (runOne())
+                continue;
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleeping++;
+            wake.wait(lock, [this]() { return stopping || queued > 0; });
+            sleeping--;
+            if (stopping)
+                return;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,84 @@
+//
+//  lod.h
+//  3D Object Drawing
+//
+//  Levels of detail of a mesh and the choice between them. Each level knows
+//  how far its facets stray from the true surface, relative to its bounding
+//  radius; an object draws the coarsest level whose error, projected to the
+//  screen at the object's distance, stays under a pixel tolerance. So a lamp
+//  shade up close gets every segment and one across a building a handful.
+//
+
+#ifndef LOD_H
+#define LOD_H
+
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+#include "mesh.h"
+
+#include <cfloat>
+#include <vector>
+
+struct LodChain
+{
+    // finest first
+    std::vector<Mesh> levels;
+    // error of each level over the radius of its bounding sphere
+    std::vector<float> errors;
+
+    // the coarsest level whose error stays within tolerance pixels on an object radiusPixels across
+    unsigned int select(float radiusPixels, float tolerance) const
+    {
+        unsigned int level = 0;
+        while (level + 1 < levels.size() && errors[level + 1] * radiusPixels <= tolerance)
+            level++;
+        return level;
+    }
+};
+
+// projects object boxes for the frame's camera
+class LodSelector
+{
+public:
+    LodSelector() : eye(0.0f), pixelsPerUnit(0.0f), tolerance(1.0f)
+    {
+    }
+
+    // pixels the facets of a level may stray from the surface; 0 always draws the finest level
+    void setTolerance(float pixels) { tolerance = pixels; }
+    float getTolerance() const { return tolerance; }
+
+    // once per frame; viewportHeight in pixels
+    void setView(const glm::vec3& cameraPosition, const glm::mat4& projection, float viewportHeight)
+    {
+        eye = cameraPosition;
+        // projection[1][1] is 1 / tan(fovy / 2): a unit at distance 1 covers that much of half the viewport
+        pixelsPerUnit = projection[1][1] * viewportHeight * 0.5f;
+    }
+
+    // radius on screen of the sphere around a world box; the camera inside it sees it as huge
+    float radiusPixels(const AABB& worldBox) const
+    {
+        glm::vec3 extent = worldBox.extent();
+        float radius = glm::length(extent);
+        float distance = glm::length(worldBox.center() - eye);
+        if (distance <= radius)
+            return FLT_MAX;
+        return radius * pixelsPerUnit / distance;
+    }
+
+    const Mesh& choose(const LodChain& chain, const AABB& worldBox) const
+    {
+        if (tolerance <= 0.0f)
+            return chain.levels[0];
+        return chain.levels[chain.select(radiusPixels(worldBox), tolerance)];
+    }
+
+private:
+    glm::vec3 eye;
+    float pixelsPerUnit;
+    float tolerance;
+};
+
+#endif
@@ -9,8 +9,37 @@
 #include "camera.h"
 #include "basic_camera.h"
 #include "fan.h"
-
+#include "bedroom.h"
+#include "scene_file.h"
+#include "instancing.h"
+#include "benchmark.h"
+#include "frame_benchmark.h"
+#include "headless_context.h"
+#include "gl_extensions.h"
+#include "gpu_profiler.h"
+#include "static_scene.h"
+#include "bounds.h"
+#include "material.h"
+#include "camera_uniforms.h"
+#include "object_buffer.h"
+#include "program_cache.h"
+#include "asset_loader.h"
+#include "simulation.h"
+#include "frame_pacing.h"
+#include "job_system.h"
+#include "lod.h"
+#include "stress_scene.h"
+#include "render_queue.h"
+#include "occlusion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <future>
 #include <iostream>
+#include <vector>
 
 using namespace std;
 
@@ -19,9 +48,101 @@ void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
 
+// a section with objects in the frustum: where they are in the visible list, or in the scene
+// when nothing is culled, and the box around them
+struct SectionView
+{
+    unsigned int section;
+    size_t begin, end;
+    AABB box;
+    bool drawFirst;
+};
+
+// GPU state a frame draws with
+struct FrameResources
+{
+    InstanceBatch batch;
+    // model matrix and color of every object, indexed by the instances
+    ObjectBuffer objects;
+    CameraUniforms camera;
+    // GPU time and a debug group per piece of furniture
+    GpuProfiler profiler;
+    // threads for the CPU side of the frame
+    JobSystem* jobs;
+    // which level of a round mesh each object draws
+    LodSelector lod;
+    // the frame's opaque draws, sorted by state and depth before they go out: the sections
+    // drawn first, and the sections left to the occlusion tests
+    RenderQueue queue, later;
+    // the translucent draws of every section, kept for one back to front pass at the end
+    RenderQueue translucent;
+    RenderState state;
+    // sections hidden behind what was drawn last frame are left to the GPU to skip
+    OcclusionCuller occlusion;
+    std::vector<SectionView> sectionsInView;
+
+    FrameResources() : jobs(NULL)
+    {
+    }
+
+    // must run while the GL context is still current
+    void release()
+    {
+        profiler.release();
+        occlusion.release();
+        camera.release();
+        objects.release();
+        batch.release();
+    }
+};
+
+// assets on their way from the loader threads to the GPU
+struct PendingAssets
+{
+    std::future<bool> shaderSources;
+    std::string vertexCode, fragmentCode;
+    std::future<bool> sceneSource;
+    SceneSource source;
+    SceneStreamer streamer;
+    bool shaderStarted, sceneStarted, shaderDone, sceneDone;
+    std::chrono::steady_clock::time_point shadersReady, sceneReady;
+
+    PendingAssets() : shaderStarted(false), sceneStarted(false), shaderDone(false), sceneDone(false)
+    {
+    }
+
+    bool done() const { return shaderDone && sceneDone; }
+};
+
+bool continueLoading(PendingAssets& pending, Shader& shader, ProgramCache& programs, StaticScene& scene, MaterialTable& materials, LoadedScene& loaded, Fan& fan);
+void queueObject(const Shader& shader, FrameResources& frame, RenderQueue& opaque, const StaticScene& scene, const MaterialTable& materials, unsigned int object, unsigned int section);
+void drawQueue(Shader& shader, FrameResources& frame, const StaticScene& scene, const MaterialTable& materials, RenderQueue& queue, bool bySection, bool conditional);
+void queueSection(const Shader& shader, FrameResources& frame, RenderQueue& opaque, const StaticScene& scene, const MaterialTable& materials, const SectionView& section, const std::vector<unsigned int>* visible);
+void queueFrame(const Shader& shader, FrameResources& frame, StaticScene& scene, const MaterialTable& materials, const glm::vec3& eye, const glm::mat4& viewProjection, const std::vector<unsigned int>* visible);
+// animation, when given, is a submitted job that moves scene nodes; the frame's scene update waits for it
+void renderFrame(Shader& shader, FrameResources& frame, StaticScene& scene, const MaterialTable& materials, Camera& viewer, JobSystem::Job* animation = NULL);
+SimulationState captureState();
+void simulateTick(float seconds);
+SimulationState stepSimulation(double frameSeconds);
+
 // settings
 const unsigned int SCR_WIDTH = 800;
 const unsigned int SCR_HEIGHT = 600;
+// vertex and index bytes uploaded per frame while a scene streams in, so a big scene costs
+// more frames to appear instead of a longer wait before the first one
+const size_t UPLOAD_BYTES_PER_FRAME = 4 * 1024 * 1024;
+// group objects that share a mesh into one instanced draw per mesh, or one multi-draw for all of them
+bool instanced_draw = true;
+// skip objects outside the view frustum
+bool frustum_culling = true;
+// with the camera in a room, skip the rooms not seen through its windows and doors
+bool portal_culling = true;
+// follows the framebuffer, for projecting objects to pixels when picking their level of detail
+unsigned int viewport_height = SCR_HEIGHT;
+// resolved once after the shader is linked
+Uniform<glm::mat4> modelUniform;
+Uniform<glm::vec4> materialColorUniform;
+Uniform<bool> instancedUniform;
 
 // modelling transform
 float rotateAngle_X = 0.0;
@@ -38,6 +159,9 @@ float scale_Y = 1.0;
 float scale_Z = 1.0;
 bool fan_turn = false;
 bool rotate_around = false;
+// degrees per second; 5 degrees per frame at 60 frames per second
+const float FAN_SPEED = 300.0f;
+float fan_angle = 0.0f;
 
 // camera
 Camera camera(glm::vec3(-1.0f, 2.5f, 3.0f));
@@ -54,802 +178,319 @@ BasicCamera basic_camera(eyeX, eyeY, eyeZ, lookAtX, lookAtY, lookAtZ, V);
 float deltaTime = 0.0f;    // time between current frame and last frame
 float lastFrame = 0.0f;
 
-glm::mat4 transforamtion(float tx, float ty, float tz, float rx, float ry, float rz, float sx, float sy, float sz) {
-    glm::mat4 identityMatrix = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
-    glm::mat4 translateMatrix, rotateXMatrix, rotateYMatrix, rotateZMatrix, scaleMatrix, model;
-    translateMatrix = glm::translate(identityMatrix, glm::vec3(tx, ty, tz));
-    rotateXMatrix = glm::rotate(identityMatrix, glm::radians(rx), glm::vec3(1.0f, 0.0f, 0.0f));
-    rotateYMatrix = glm::rotate(identityMatrix, glm::radians(ry), glm::vec3(0.0f, 1.0f, 0.0f));
-    rotateZMatrix = glm::rotate(identityMatrix, glm::radians(rz), glm::vec3(0.0f, 0.0f, 1.0f));
-    scaleMatrix = glm::scale(identityMatrix, glm::vec3(sx, sy, sz));
-    model = translateMatrix * rotateXMatrix * rotateYMatrix * rotateZMatrix * scaleMatrix;
-    return model;
-}
+// simulation: fixed ticks, frames interpolate between the last two
+FixedTimestep timestep(60.0);
+SimulationState previousState, currentState;
+// movement keys held this frame, applied on every tick
+bool movement_held[R_RIGHT + 1] = {};
+// when frames start, and how old their input is by the time they are shown
+FramePacer pacer;
+LatencyMeter latency;
+
+// benchmark frames advance the simulation by a constant time, so every run animates the same
+const double BENCHMARK_FRAME_SECONDS = 1.0 / 60.0;
 
-int main()
+int main(int argc, char** argv)
 {
-    // glfw: initialize and configure
-    // ------------------------------
-    glfwInit();
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    const char* scenePath = NULL;
+    const char* exportScenePath = NULL;
+    const char* benchmarkOutPath = NULL;
+    bool benchUniforms = false;
+    bool gpuProfile = false;
+    bool multiDraw = true;
+    bool occlusionCulling = true;
+    float lodError = 1.0f;
+    VertexFormat vertexFormat = VERTEX_COMPACT;
+    bool mergeStatic = true;
+    float mergeChunkSize = MERGE_CHUNK_SIZE;
+    bool programCache = true;
+    const char* programCacheDirectory = "shader_cache";
+    int benchmarkFrames = 0;
+    double tickRate = 60.0;
+    unsigned int jobThreads = 0;
+    PacingMode pacing = PACING_VSYNC;
+    bool measureLatency = false;
+    const char* latencyLogPath = NULL;
+    bool stress = false;
+    StressSceneOptions stressOptions;
+    for (int arg = 1; arg < argc; arg++)
+    {
+        if (strcmp(argv[arg], "--scene") == 0 && arg + 1 < argc)
+            scenePath = argv[++arg];
+        else if (strcmp(argv[arg], "--export-scene") == 0 && arg + 1 < argc)
+            exportScenePath = argv[++arg];
+        else if (strcmp(argv[arg], "--bench-uniforms") == 0)
+            benchUniforms = true;
+        else if (strcmp(argv[arg], "--bench-transforms") == 0)
+        {
+            // CPU only, no window or context needed
+            benchmarkTransformCompose();
+            return 0;
+        }
+        else if (strcmp(argv[arg], "--benchmark") == 0 && arg + 1 < argc)
+            benchmarkFrames = atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "--benchmark-out") == 0 && arg + 1 < argc)
+            benchmarkOutPath = argv[++arg];
+        else if (strcmp(argv[arg], "--gpu-profile") == 0)
+            gpuProfile = true;
+        else if (strcmp(argv[arg], "--no-cull") == 0)
+            frustum_culling = false;
+        else if (strcmp(argv[arg], "--no-portals") == 0)
+            portal_culling = false;
+        else if (strcmp(argv[arg], "--no-occlusion") == 0)
+            occlusionCulling = false;
+        else if (strcmp(argv[arg], "--no-mdi") == 0)
+            multiDraw = false;
+        else if (strcmp(argv[arg], "--no-instancing") == 0)
+            instanced_draw = false;
+        else if (strcmp(argv[arg], "--float-vertices") == 0)
+            vertexFormat = VERTEX_FLOAT;
+        else if (strcmp(argv[arg], "--no-merge") == 0)
+            mergeStatic = false;
+        else if (strcmp(argv[arg], "--merge-chunk") == 0 && arg + 1 < argc)
+            mergeChunkSize = (float)atof(argv[++arg]);
+        else if (strcmp(argv[arg], "--lod-error") == 0 && arg + 1 < argc)
+            lodError = (float)atof(argv[++arg]);
+        else if (strcmp(argv[arg], "--shader-cache") == 0 && arg + 1 < argc)
+            programCacheDirectory = argv[++arg];
+        else if (strcmp(argv[arg], "--no-shader-cache") == 0)
+            programCache = false;
+        else if (strcmp(argv[arg], "--tick-rate") == 0 && arg + 1 < argc)
+            tickRate = atof(argv[++arg]);
+        else if (strcmp(argv[arg], "--jobs") == 0 && arg + 1 < argc)
+            jobThreads = (unsigned int)atoi(argv[++arg]);
+        else if (strcmp(argv[arg], "--pacing") == 0 && arg + 1 < argc)
+        {
+            if (!parsePacingMode(argv[++arg], pacing))
+                std::cout << "ERROR::PACING::UNKNOWN_MODE: " << argv[arg] << std::endl;
+        }
+        else if (strcmp(argv[arg], "--stress") == 0 && arg + 1 < argc)
+        {
+            stress = true;
+            if (!parseStressSize(argv[++arg], stressOptions))
+                std::cout << "ERROR::STRESS::BAD_SIZE: " << argv[arg] << std::endl;
+        }
+        else if (strcmp(argv[arg], "--stress-objects") == 0 && arg + 1 < argc)
+        {
+            stress = true;
+            stressOptions.targetObjects = (size_t)strtoull(argv[++arg], NULL, 10);
+        }
+        else if (strcmp(argv[arg], "--stress-seed") == 0 && arg + 1 < argc)
+            stressOptions.seed = (uint32_t)strtoul(argv[++arg], NULL, 10);
+        else if (strcmp(argv[arg], "--stress-jitter") == 0 && arg + 1 < argc)
+            stressOptions.jitter = (float)atof(argv[++arg]);
+        else if (strcmp(argv[arg], "--stress-fans") == 0 && arg + 1 < argc)
+            stressOptions.spinningFans = (float)atof(argv[++arg]);
+        else if (strcmp(argv[arg], "--latency") == 0)
+            measureLatency = true;
+        else if (strcmp(argv[arg], "--latency-log") == 0 && arg + 1 < argc)
+        {
+            measureLatency = true;
+            latencyLogPath = argv[++arg];
+        }
+    }
 
-#ifdef __APPLE__
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-#endif
+    // startup phases, reported by the benchmark
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point launched = Clock::now();
 
-    // glfw window creation
-    // --------------------
-    GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "CSE 4208: Computer Graphics Laboratory", NULL, NULL);
-    if (window == NULL)
+    // the benchmark runs without a window, so it also works on machines without a display
+    HeadlessContext headless;
+    GLFWwindow* window = NULL;
+    if (benchmarkFrames > 0)
     {
-        std::cout << "Failed to create GLFW window" << std::endl;
-        glfwTerminate();
-        return -1;
+        if (!headless.create(SCR_WIDTH, SCR_HEIGHT))
+            return -1;
     }
-    glfwMakeContextCurrent(window);
-    glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
-    glfwSetCursorPosCallback(window, mouse_callback);
-    glfwSetScrollCallback(window, scroll_callback);
+    else
+    {
+        // glfw: initialize and configure
+        // ------------------------------
+        glfwInit();
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+#ifdef __APPLE__
+        glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
 
-    // glad: load all OpenGL function pointers
-    // ---------------------------------------
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
-    {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
+        // glfw window creation
+        // --------------------
+        window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "CSE 4208: Computer Graphics Laboratory", NULL, NULL);
+        if (window == NULL)
+        {
+            std::cout << "Failed to create GLFW window" << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        glfwMakeContextCurrent(window);
+        glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+        glfwSetCursorPosCallback(window, mouse_callback);
+        glfwSetScrollCallback(window, scroll_callback);
+
+        // tell GLFW to capture our mouse
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+
+        // glad: load all OpenGL function pointers
+        // ---------------------------------------
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+        {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
+        glExtensions().load((GLADloadproc)glfwGetProcAddress);
     }
 
+    Clock::time_point contextReady = Clock::now();
+
     // configure global opengl state
     // -----------------------------
     glEnable(GL_DEPTH_TEST);
+    // let the driver decide how many threads compile shaders
+    if (glExtensions().parallelShaderCompile)
+        glExtensions().maxShaderCompilerThreads(0xFFFFFFFFu);
 
-    // build and compile our shader zprogram
-    // ------------------------------------
-    Shader ourShader("vertexShader.vs", "fragmentShader.fs");
+    ProgramCache programs(programCacheDirectory);
+    programs.setEnabled(programCache);
+    if (benchUniforms)
+    {
+        Shader benchShader("vertexShader.vs", "fragmentShader.fs", &programs);
+        benchShader.use();
+        benchmarkUniformUpload(benchShader);
+        glfwTerminate();
+        return 0;
+    }
 
-    // set up vertex data (and buffer(s)) and configure vertex attributes
-    // ------------------------------------------------------------------
-    
-    //axis line 
-
-    float cube_vertices2[] = {
-        -0.25f, -0.25f, -0.25f, 0.0f, 0.0f, 0.0f,
-        0.25f, -0.25f, -0.25f, 0.0f, 0.0f, 0.0f,
-        0.25f, 0.25f, -0.25f, 0.0f, 0.0f, 0.0f,
-        -0.25f, 0.25f, -0.25f, 0.0f, 0.0f, 0.0f,
-        -0.25f, -0.25f, 0.25f, 0.3f, 0.8f, 0.5f,
-        0.25f, -0.25f, 0.25f, 0.5f, 0.4f, 0.3f,
-        0.25f, 0.25f, 0.25f, 0.2f, 0.7f, 0.3f,
-        -0.25f, 0.25f, 0.25f, 0.6f, 0.2f, 0.8f,
-    };
-
-    float cube_vertices[] = {
-        0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-        0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f,
-        0.5f, 0.5f, 0.0f, 1.0f, 0.0f, 0.0f,
-        0.0f, 0.5f, 0.0f, 1.0f, 0.0f, 0.0f,
-
-        0.5f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f,
-        0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 0.0f,
-        0.5f, 0.0f, 0.5f, 0.0f, 1.0f, 0.0f,
-        0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 0.0f,
-
-        0.0f, 0.0f, 0.5f, 0.0f, 0.0f, 1.0f,
-        0.5f, 0.0f, 0.5f, 0.0f, 0.0f, 1.0f,
-        0.5f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f,
-        0.0f, 0.5f, 0.5f, 0.0f, 0.0f, 1.0f,
-
-        0.0f, 0.0f, 0.5f, 1.0f, 1.0f, 0.0f,
-        0.0f, 0.5f, 0.5f, 1.0f, 1.0f, 0.0f,
-        0.0f, 0.5f, 0.0f, 1.0f, 1.0f, 0.0f,
-        0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 0.0f,
-
-        0.5f, 0.5f, 0.5f, 0.0f, 1.0f, 1.0f,
-        0.5f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f,
-        0.0f, 0.5f, 0.0f, 0.0f, 1.0f, 1.0f,
-        0.0f, 0.5f, 0.5f, 0.0f, 1.0f, 1.0f,
-
-        0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-        0.5f, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f,
-        0.5f, 0.0f, 0.5f, 1.0f, 0.0f, 1.0f,
-        0.0f, 0.0f, 0.5f, 1.0f, 0.0f, 1.0f
-    };
-    unsigned int cube_indices[] = {
-        0, 3, 2,
-        2, 1, 0,
-
-        4, 5, 7,
-        7, 6, 4,
-
-        8, 9, 10,
-        10, 11, 8,
-
-        12, 13, 14,
-        14, 15, 12,
-
-        16, 17, 18,
-        18, 19, 16,
-
-        20, 21, 22,
-        22, 23, 20
-    };
-    float floor[] = {
-        0.0f, 0.0f, 0.0f, 0.69f, 0.69f, 0.69f,
-        0.5f, 0.0f, 0.0f, 0.69f, 0.69f, 0.69f,
-        0.5f, 0.5f, 0.0f, 0.69f, 0.69f, 0.69f,
-        0.0f, 0.5f, 0.0f, 0.69f, 0.69f, 0.69f,
-
-        0.5f, 0.0f, 0.0f, 0.69f, 0.69f, 0.69f,
-        0.5f, 0.5f, 0.0f, 0.69f, 0.69f, 0.69f,
-        0.5f, 0.0f, 0.5f, 0.69f, 0.69f, 0.69f,
-        0.5f, 0.5f, 0.5f, 0.69f, 0.69f, 0.69f,
-
-        0.0f, 0.0f, 0.5f, 0.69f, 0.69f, 0.69f,
-        0.5f, 0.0f, 0.5f, 0.69f, 0.69f, 0.69f,
-        0.5f, 0.5f, 0.5f, 0.69f, 0.69f, 0.69f,
-        0.0f, 0.5f, 0.5f, 0.69f, 0.69f, 0.69f,
-
-        0.0f, 0.0f, 0.5f, 0.69f, 0.69f, 0.69f,
-        0.0f, 0.5f, 0.5f, 0.69f, 0.69f, 0.69f,
-        0.0f, 0.5f, 0.0f, 0.69f, 0.69f, 0.69f,
-        0.0f, 0.0f, 0.0f, 0.69f, 0.69f, 0.69f,
-
-        0.5f, 0.5f, 0.5f, 0.69f, 0.69f, 0.69f,
-        0.5f, 0.5f, 0.0f, 0.69f, 0.69f, 0.69f,
-        0.0f, 0.5f, 0.0f, 0.69f, 0.69f, 0.69f,
-        0.0f, 0.5f, 0.5f, 0.69f, 0.69f, 0.69f,
-
-        0.0f, 0.0f, 0.0f, 0.69f, 0.69f, 0.69f,
-        0.5f, 0.0f, 0.0f, 0.69f, 0.69f, 0.69f,
-        0.5f, 0.0f, 0.5f, 0.69f, 0.69f, 0.69f,
-        0.0f, 0.0f, 0.5f, 0.69f, 0.69f, 0.69f
-    };
-    //0.92f, 0.91f, 0.83f,
-    float wall1[] = {
-        0.0f, 0.0f, 0.0f, 0.92f, 0.91f, 0.83f,
-        0.5f, 0.0f, 0.0f, 0.92f, 0.91f, 0.83f,
-        0.5f, 0.5f, 0.0f, 0.92f, 0.91f, 0.83f,
-        0.0f, 0.5f, 0.0f, 0.92f, 0.91f, 0.83f,
-
-        0.5f, 0.0f, 0.0f, 0.92f, 0.91f, 0.83f,
-        0.5f, 0.5f, 0.0f, 0.92f, 0.91f, 0.83f,
-        0.5f, 0.0f, 0.5f, 0.92f, 0.91f, 0.83f,
-        0.5f, 0.5f, 0.5f, 0.92f, 0.91f, 0.83f,
-
-        0.0f, 0.0f, 0.5f, 0.92f, 0.91f, 0.83f,
-        0.5f, 0.0f, 0.5f, 0.92f, 0.91f, 0.83f,
-        0.5f, 0.5f, 0.5f, 0.92f, 0.91f, 0.83f,
-        0.0f, 0.5f, 0.5f, 0.92f, 0.91f, 0.83f,
-
-        0.0f, 0.0f, 0.5f, 0.92f, 0.91f, 0.83f,
-        0.0f, 0.5f, 0.5f, 0.92f, 0.91f, 0.83f,
-        0.0f, 0.5f, 0.0f, 0.92f, 0.91f, 0.83f,
-        0.0f, 0.0f, 0.0f, 0.92f, 0.91f, 0.83f,
-
-        0.5f, 0.5f, 0.5f, 0.92f, 0.91f, 0.83f,
-        0.5f, 0.5f, 0.0f, 0.92f, 0.91f, 0.83f,
-        0.0f, 0.5f, 0.0f, 0.92f, 0.91f, 0.83f,
-        0.0f, 0.5f, 0.5f, 0.92f, 0.91f, 0.83f,
-
-        0.0f, 0.0f, 0.0f, 0.92f, 0.91f, 0.83f,
-        0.5f, 0.0f, 0.0f, 0.92f, 0.91f, 0.83f,
-        0.5f, 0.0f, 0.5f, 0.92f, 0.91f, 0.83f,
-        0.0f, 0.0f, 0.5f, 0.92f, 0.91f, 0.83f
-    };
-
-    //0.99f, 0.84f, 0.70f,
-    float wall2[] = {
-        0.0f, 0.0f, 0.0f, 0.99f, 0.84f, 0.70f,
-        0.5f, 0.0f, 0.0f, 0.99f, 0.84f, 0.70f,
-        0.5f, 0.5f, 0.0f, 0.99f, 0.84f, 0.70f,
-        0.0f, 0.5f, 0.0f, 0.99f, 0.84f, 0.70f,
-
-        0.5f, 0.0f, 0.0f, 0.99f, 0.84f, 0.70f,
-        0.5f, 0.5f, 0.0f, 0.99f, 0.84f, 0.70f,
-        0.5f, 0.0f, 0.5f, 0.99f, 0.84f, 0.70f,
-        0.5f, 0.5f, 0.5f, 0.99f, 0.84f, 0.70f,
-
-        0.0f, 0.0f, 0.5f, 0.99f, 0.84f, 0.70f,
-        0.5f, 0.0f, 0.5f, 0.99f, 0.84f, 0.70f,
-        0.5f, 0.5f, 0.5f, 0.99f, 0.84f, 0.70f,
-        0.0f, 0.5f, 0.5f, 0.99f, 0.84f, 0.70f,
-
-        0.0f, 0.0f, 0.5f, 0.99f, 0.84f, 0.70f,
-        0.0f, 0.5f, 0.5f, 0.99f, 0.84f, 0.70f,
-        0.0f, 0.5f, 0.0f, 0.99f, 0.84f, 0.70f,
-        0.0f, 0.0f, 0.0f, 0.99f, 0.84f, 0.70f,
-
-        0.5f, 0.5f, 0.5f, 0.99f, 0.84f, 0.70f,
-        0.5f, 0.5f, 0.0f, 0.99f, 0.84f, 0.70f,
-        0.0f, 0.5f, 0.0f, 0.99f, 0.84f, 0.70f,
-        0.0f, 0.5f, 0.5f, 0.99f, 0.84f, 0.70f,
-
-        0.0f, 0.0f, 0.0f, 0.99f, 0.84f, 0.70f,
-        0.5f, 0.0f, 0.0f, 0.99f, 0.84f, 0.70f,
-        0.5f, 0.0f, 0.5f, 0.99f, 0.84f, 0.70f,
-        0.0f, 0.0f, 0.5f, 0.99f, 0.84f, 0.70f
-    };
-
-    float box[] = {
-        0.0f, 0.0f, 0.0f, 0.647f, 0.165f, 0.165f,
-        0.5f, 0.0f, 0.0f, 0.647f, 0.165f, 0.165f,
-        0.5f, 0.5f, 0.0f, 0.647f, 0.165f, 0.165f,
-        0.0f, 0.5f, 0.0f, 0.647f, 0.165f, 0.165f,
-
-        0.5f, 0.0f, 0.0f, 0.647f, 0.165f, 0.165f,
-        0.5f, 0.5f, 0.0f, 0.647f, 0.165f, 0.165f,
-        0.5f, 0.0f, 0.5f, 0.647f, 0.165f, 0.165f,
-        0.5f, 0.5f, 0.5f, 0.647f, 0.165f, 0.165f,
-
-        0.0f, 0.0f, 0.5f, 0.647f, 0.165f, 0.165f,
-        0.5f, 0.0f, 0.5f, 0.647f, 0.165f, 0.165f,
-        0.5f, 0.5f, 0.5f, 0.647f, 0.165f, 0.165f,
-        0.0f, 0.5f, 0.5f, 0.647f, 0.165f, 0.165f,
-
-        0.0f, 0.0f, 0.5f, 0.647f, 0.165f, 0.165f,
-        0.0f, 0.5f, 0.5f, 0.647f, 0.165f, 0.165f,
-        0.0f, 0.5f, 0.0f, 0.647f, 0.165f, 0.165f,
-        0.0f, 0.0f, 0.0f, 0.647f, 0.165f, 0.165f,
-
-        0.5f, 0.5f, 0.5f, 0.647f, 0.165f, 0.165f,
-        0.5f, 0.5f, 0.0f, 0.647f, 0.165f, 0.165f,
-        0.0f, 0.5f, 0.0f, 0.647f, 0.165f, 0.165f,
-        0.0f, 0.5f, 0.5f, 0.647f, 0.165f, 0.165f,
-
-        0.0f, 0.0f, 0.0f, 0.647f, 0.165f, 0.165f,
-        0.5f, 0.0f, 0.0f, 0.647f, 0.165f, 0.165f,
-        0.5f, 0.0f, 0.5f, 0.647f, 0.165f, 0.165f,
-        0.0f, 0.0f, 0.5f, 0.647f, 0.165f, 0.165f
-    };
-
-    float box2[] = {
-        0.0f, 0.0f, 0.0f, 0.1f, 0.714f, 0.757f,
-        0.5f, 0.0f, 0.0f, 0.1f, 0.714f, 0.757f,
-        0.5f, 0.5f, 0.0f, 0.1f, 0.714f, 0.757f,
-        0.0f, 0.5f, 0.0f, 0.1f, 0.714f, 0.757f,
-
-        0.5f, 0.0f, 0.0f, 0.1f, 0.714f, 0.757f,
-        0.5f, 0.5f, 0.0f, 0.1f, 0.714f, 0.757f,
-        0.5f, 0.0f, 0.5f, 0.1f, 0.714f, 0.757f,
-        0.5f, 0.5f, 0.5f, 0.1f, 0.714f, 0.757f,
-
-        0.0f, 0.0f, 0.5f, 0.1f, 0.714f, 0.757f,
-        0.5f, 0.0f, 0.5f, 0.1f, 0.714f, 0.757f,
-        0.5f, 0.5f, 0.5f, 0.1f, 0.714f, 0.757f,
-        0.0f, 0.5f, 0.5f, 0.1f, 0.714f, 0.757f,
-
-        0.0f, 0.0f, 0.5f, 0.1f, 0.714f, 0.757f,
-        0.0f, 0.5f, 0.5f, 0.1f, 0.714f, 0.757f,
-        0.0f, 0.5f, 0.0f, 0.1f, 0.714f, 0.757f,
-        0.0f, 0.0f, 0.0f, 0.1f, 0.714f, 0.757f,
-
-        0.5f, 0.5f, 0.5f, 0.1f, 0.714f, 0.757f,
-        0.5f, 0.5f, 0.0f, 0.1f, 0.714f, 0.757f,
-        0.0f, 0.5f, 0.0f, 0.1f, 0.714f, 0.757f,
-        0.0f, 0.5f, 0.5f, 0.1f, 0.714f, 0.757f,
-
-        0.0f, 0.0f, 0.0f, 0.1f, 0.714f, 0.757f,
-        0.5f, 0.0f, 0.0f, 0.1f, 0.714f, 0.757f,
-        0.5f, 0.0f, 0.5f, 0.1f, 0.714f, 0.757f,
-        0.0f, 0.0f, 0.5f, 0.1f, 0.714f, 0.757f
-    };
-
-    float ac[] = {
-        0.0f, 0.0f, 0.0f,0.2f, 0.2f, 0.2f,
-        0.25f, 0.0f, 0.0f, 0.2f, 0.2f, 0.2f,
-        0.25f, 0.25f, 0.0f, 0.2f, 0.2f, 0.2f,
-        0.0f, 0.5f, 0.0f, 0.2f, 0.2f, 0.2f,
-
-        0.25f, 0.0f, 0.0f, 0.8f, 0.8f, 0.8f,
-        0.25f, 0.25f, 0.0f, 0.8f, 0.8f, 0.8f,
-        0.25f, 0.0f, 0.5f, 0.8f, 0.8f, 0.8f,
-        0.25f, 0.25f, 0.5f, 0.8f, 0.8f, 0.8f,
-
-        0.0f, 0.0f, 0.5f, 0.2f, 0.2f, 0.2f,
-        0.25f, 0.0f, 0.5f, 0.2f, 0.2f, 0.2f,
-        0.25f, 0.25f, 0.5f, 0.2f, 0.2f, 0.2f,
-        0.0f, 0.5f, 0.5f, 0.2f, 0.2f, 0.2f,
-
-        0.0f, 0.0f, 0.5f, 0.2f, 0.2f, 0.2f,
-        0.0f, 0.5f, 0.5f, 0.2f, 0.2f, 0.2f,
-        0.0f, 0.5f, 0.0f, 0.2f, 0.2f, 0.2f,
-        0.0f, 0.0f, 0.0f, 0.2f, 0.2f, 0.2f,
-
-        0.25f, 0.25f, 0.5f, 0.2f, 0.2f, 0.2f,
-        0.25f, 0.25f, 0.0f, 0.2f, 0.2f, 0.2f,
-        0.0f, 0.5f, 0.0f, 0.2f, 0.2f, 0.2f,
-        0.0f, 0.5f, 0.5f, 0.2f, 0.2f, 0.2f,
-
-        0.0f, 0.0f, 0.0f, 0.2f, 0.2f, 0.2f,
-        0.25f, 0.0f, 0.0f, 0.2f, 0.2f, 0.2f,
-        0.25f, 0.0f, 0.5f, 0.2f, 0.2f, 0.2f,
-        0.0f, 0.0f, 0.5f, 0.2f, 0.2f, 0.2f
-    };
-
-    float ceiling[] = {
-        0.0f, 0.0f, 0.0f, 0.95f, 0.95f, 0.95f,
-        0.5f, 0.0f, 0.0f, 0.95f, 0.95f, 0.95f,
-        0.5f, 0.5f, 0.0f, 0.95f, 0.95f, 0.95f,
-        0.0f, 0.5f, 0.0f, 0.95f, 0.95f, 0.95f,
-
-        0.5f, 0.0f, 0.0f, 0.95f, 0.95f, 0.95f,
-        0.5f, 0.5f, 0.0f, 0.95f, 0.95f, 0.95f,
-        0.5f, 0.0f, 0.5f, 0.95f, 0.95f, 0.95f,
-        0.5f, 0.5f, 0.5f, 0.95f, 0.95f, 0.95f,
-
-        0.0f, 0.0f, 0.5f, 0.95f, 0.95f, 0.95f,
-        0.5f, 0.0f, 0.5f, 0.95f, 0.95f, 0.95f,
-        0.5f, 0.5f, 0.5f, 0.95f, 0.95f, 0.95f,
-        0.0f, 0.5f, 0.5f, 0.95f, 0.95f, 0.95f,
-
-        0.0f, 0.0f, 0.5f, 0.95f, 0.95f, 0.95f,
-        0.0f, 0.5f, 0.5f, 0.95f, 0.95f, 0.95f,
-        0.0f, 0.5f, 0.0f, 0.95f, 0.95f, 0.95f,
-        0.0f, 0.0f, 0.0f, 0.95f, 0.95f, 0.95f,
-
-        0.5f, 0.5f, 0.5f, 0.95f, 0.95f, 0.95f,
-        0.5f, 0.5f, 0.0f, 0.95f, 0.95f, 0.95f,
-        0.0f, 0.5f, 0.0f, 0.95f, 0.95f, 0.95f,
-        0.0f, 0.5f, 0.5f, 0.95f, 0.95f, 0.95f,
-
-        0.0f, 0.0f, 0.0f, 0.95f, 0.95f, 0.95f,
-        0.5f, 0.0f, 0.0f, 0.95f, 0.95f, 0.95f,
-        0.5f, 0.0f, 0.5f, 0.95f, 0.95f, 0.95f,
-        0.0f, 0.0f, 0.5f, 0.95f, 0.95f, 0.95f
-    };
-
-    float fan_holder[] = {
-        0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-        0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-        0.5f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f,
-        0.0f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f,
-
-        0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-        0.5f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f,
-        0.5f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f,
-        0.5f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f,
-
-        0.0f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f,
-        0.5f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f,
-        0.5f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f,
-        0.0f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f,
-
-        0.0f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f,
-        0.0f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f,
-        0.0f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f,
-        0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-
-        0.5f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f,
-        0.5f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f,
-        0.0f, 0.5f, 0.0f, 1.0f, 1.0f, 1.0f,
-        0.0f, 0.5f, 0.5f, 1.0f, 1.0f, 1.0f,
-
-        0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-        0.5f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f,
-        0.5f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f,
-        0.0f, 0.0f, 0.5f, 1.0f, 1.0f, 1.0f
-    };
-    float fan_pivot[] = {
-        0.0f, 0.0f, 0.0f, .44f, .22f, .05f,
-        0.5f, 0.0f, 0.0f, .44f, .22f, .05f,
-        0.5f, 0.5f, 0.0f, .44f, .22f, .05f,
-        0.0f, 0.5f, 0.0f, .44f, .22f, .05f,
-
-        0.5f, 0.0f, 0.0f, .44f, .22f, .05f,
-        0.5f, 0.5f, 0.0f, .44f, .22f, .05f,
-        0.5f, 0.0f, 0.5f, .44f, .22f, .05f,
-        0.5f, 0.5f, 0.5f, .44f, .22f, .05f,
-
-        0.0f, 0.0f, 0.5f, .44f, .22f, .05f,
-        0.5f, 0.0f, 0.5f, .44f, .22f, .05f,
-        0.5f, 0.5f, 0.5f, .44f, .22f, .05f,
-        0.0f, 0.5f, 0.5f, .44f, .22f, .05f,
-
-        0.0f, 0.0f, 0.5f, .44f, .22f, .05f,
-        0.0f, 0.5f, 0.5f, .44f, .22f, .05f,
-        0.0f, 0.5f, 0.0f, .44f, .22f, .05f,
-        0.0f, 0.0f, 0.0f, .44f, .22f, .05f,
-
-        0.5f, 0.5f, 0.5f, .44f, .22f, .05f,
-        0.5f, 0.5f, 0.0f, .44f, .22f, .05f,
-        0.0f, 0.5f, 0.0f, .44f, .22f, .05f,
-        0.0f, 0.5f, 0.5f, .44f, .22f, .05f,
-
-        0.0f, 0.0f, 0.0f, .44f, .22f, .05f,
-        0.5f, 0.0f, 0.0f, .44f, .22f, .05f,
-        0.5f, 0.0f, 0.5f, .44f, .22f, .05f,
-        0.0f, 0.0f, 0.5f, .44f, .22f, .05f
-    };
-    float fan_blade[] = {
-        0.0f, 0.0f, 0.0f, .0f, .0f, .42f,
-        0.5f, 0.0f, 0.0f, .0f, .0f, .42f,
-        0.5f, 0.5f, 0.0f, .0f, .0f, .42f,
-        0.0f, 0.5f, 0.0f, .0f, .0f, .42f,
-
-        0.5f, 0.0f, 0.0f, .0f, .0f, .42f,
-        0.5f, 0.5f, 0.0f, .0f, .0f, .42f,
-        0.5f, 0.0f, 0.5f, .0f, .0f, .42f,
-        0.5f, 0.5f, 0.5f, .0f, .0f, .42f,
-
-        0.0f, 0.0f, 0.5f, .0f, .0f, .42f,
-        0.5f, 0.0f, 0.5f, .0f, .0f, .42f,
-        0.5f, 0.5f, 0.5f, .0f, .0f, .42f,
-        0.0f, 0.5f, 0.5f, .0f, .0f, .42f,
-
-        0.0f, 0.0f, 0.5f, .0f, .0f, .42f,
-        0.0f, 0.5f, 0.5f, .0f, .0f, .42f,
-        0.0f, 0.5f, 0.0f, .0f, .0f, .42f,
-        0.0f, 0.0f, 0.0f, .0f, .0f, .42f,
-
-        0.5f, 0.5f, 0.5f, .0f, .0f, .42f,
-        0.5f, 0.5f, 0.0f, .0f, .0f, .42f,
-        0.0f, 0.5f, 0.0f, .0f, .0f, .42f,
-        0.0f, 0.5f, 0.5f, .0f, .0f, .42f,
-
-        0.0f, 0.0f, 0.0f, .0f, .0f, .42f,
-        0.5f, 0.0f, 0.0f, .0f, .0f, .42f,
-        0.5f, 0.0f, 0.5f, .0f, .0f, .42f,
-        0.0f, 0.0f, 0.5f, .0f, .0f, .42f
-    };
-
-    float glass[] = {
-        0.0f, 0.0f, 0.0f, 0.53f, 0.8f, 0.98f,
-        0.5f, 0.0f, 0.0f, 0.53f, 0.8f, 0.98f,
-        0.5f, 0.5f, 0.0f, 0.53f, 0.8f, 0.98f,
-        0.0f, 0.5f, 0.0f, 0.53f, 0.8f, 0.98f,
-
-        0.5f, 0.0f, 0.0f, 0.53f, 0.8f, 0.98f,
-        0.5f, 0.5f, 0.0f, 0.53f, 0.8f, 0.98f,
-        0.5f, 0.0f, 0.5f, 0.53f, 0.8f, 0.98f,
-        0.5f, 0.5f, 0.5f, 0.53f, 0.8f, 0.98f,
-
-        0.0f, 0.0f, 0.5f, 0.53f, 0.8f, 0.98f,
-        0.5f, 0.0f, 0.5f, 0.53f, 0.8f, 0.98f,
-        0.5f, 0.5f, 0.5f, 0.53f, 0.8f, 0.98f,
-        0.0f, 0.5f, 0.5f, 0.53f, 0.8f, 0.98f,
-
-        0.0f, 0.0f, 0.5f, 0.53f, 0.8f, 0.98f,
-        0.0f, 0.5f, 0.5f, 0.53f, 0.8f, 0.98f,
-        0.0f, 0.5f, 0.0f, 0.53f, 0.8f, 0.98f,
-        0.0f, 0.0f, 0.0f, 0.53f, 0.8f, 0.98f,
-
-        0.5f, 0.5f, 0.5f, 0.53f, 0.8f, 0.98f,
-        0.5f, 0.5f, 0.0f, 0.53f, 0.8f, 0.98f,
-        0.0f, 0.5f, 0.0f, 0.53f, 0.8f, 0.98f,
-        0.0f, 0.5f, 0.5f, 0.53f, 0.8f, 0.98f,
-
-        0.0f, 0.0f, 0.0f, 0.53f, 0.8f, 0.98f,
-        0.5f, 0.0f, 0.0f, 0.53f, 0.8f, 0.98f,
-        0.5f, 0.0f, 0.5f, 0.53f, 0.8f, 0.98f,
-        0.0f, 0.0f, 0.5f, 0.53f, 0.8f, 0.98f
-    };
-
-    float cabinate[] = {
-        0.0f, 0.0f, 0.0f, 0.29f, 0.0f, 0.29f,
-        0.5f, 0.0f, 0.0f, 0.29f, 0.0f, 0.29f,
-        0.5f, 0.5f, 0.0f, 0.29f, 0.0f, 0.29f,
-        0.0f, 0.5f, 0.0f, 0.29f, 0.0f, 0.29f,
-
-        0.5f, 0.0f, 0.0f, 0.29f, 0.0f, 0.29f,
-        0.5f, 0.5f, 0.0f, 0.29f, 0.0f, 0.29f,
-        0.5f, 0.0f, 0.5f, 0.29f, 0.0f, 0.29f,
-        0.5f, 0.5f, 0.5f, 0.29f, 0.0f, 0.29f,
-
-        0.0f, 0.0f, 0.5f, 0.29f, 0.0f, 0.29f,
-        0.5f, 0.0f, 0.5f, 0.29f, 0.0f, 0.29f,
-        0.5f, 0.5f, 0.5f, 0.29f, 0.0f, 0.29f,
-        0.0f, 0.5f, 0.5f, 0.29f, 0.0f, 0.29f,
-
-        0.0f, 0.0f, 0.5f, 0.29f, 0.0f, 0.29f,
-        0.0f, 0.5f, 0.5f, 0.29f, 0.0f, 0.29f,
-        0.0f, 0.5f, 0.0f, 0.29f, 0.0f, 0.29f,
-        0.0f, 0.0f, 0.0f, 0.29f, 0.0f, 0.29f,
-
-        0.5f, 0.5f, 0.5f, 0.29f, 0.0f, 0.29f,
-        0.5f, 0.5f, 0.0f, 0.29f, 0.0f, 0.29f,
-        0.0f, 0.5f, 0.0f, 0.29f, 0.0f, 0.29f,
-        0.0f, 0.5f, 0.5f, 0.29f, 0.0f, 0.29f,
-
-        0.0f, 0.0f, 0.0f, 0.29f, 0.0f, 0.29f,
-        0.5f, 0.0f, 0.0f, 0.29f, 0.0f, 0.29f,
-        0.5f, 0.0f, 0.5f, 0.29f, 0.0f, 0.29f,
-        0.0f, 0.0f, 0.5f, 0.29f, 0.0f, 0.29f
-    };
-    float circle_vertices5[] = {
-        0.0,.70,0.0, 0.0,0.0,0.0,
-       0.25,.70,0.0, 0.0,1.0,1.0,
-       .177,.70,0.177, 0.0,1.0,1.0,
-       0.0,.70,0.25, 0.0,1.0,1.0,
-       -.177,.70,0.177, 0.0,1.0,1.0,
-       -0.25,.70,0.0, 0.0,1.0,1.0,
-       -.177,.70,-0.177, 0.0,1.0,1.0,
-       0.0,.70,-0.25, 0.0,1.0,1.0,
-       .177,.70,-0.177, 0.0,1.0,1.0,
-
-
-       0.0,-.30,0.0, 0.0,0.0,0.0,
-       1.0 / 2,-.30,0.0, 0.0,1.0,1.0,
-       .707 / 2,-.30,.707 / 2, 0.0,1.0,1.0,
-       0.0,-.30,1.0 / 2, 0.0,1.0,1.0,
-       -.707 / 2,-.30,.707 / 2, 0.0,1.0,1.0,
-       -1.0 / 2,-.30,0.0, 0.0,1.0,1.0,
-       -.707 / 2,-.30,-.707 / 2, 0.0,1.0,1.0,
-       0.0,-.30,-1.0 / 2, 0.0,1.0,1.0,
-       .707 / 2,-.30,-.707 / 2, 0.0,1.0,1.0,
-
-    };
-    unsigned int circle_indices[] = {
-       0,1,2,
-       0,2,3,
-       0,3,4,
-       0,4,5,
-       0,5,6,
-       0,6,7,
-       0,7,8,
-       0,8,1,
-
-       9,10,11,
-       9,11,12,
-       9,12,13,
-       9,13,14,
-       9,14,15,
-       9,15,16,
-       9,16,17,
-       9,17,10,
-
-       1,10,2,
-       10,11,2,
-       11,2,12,
-       2,12,3,
-       3,12,13,
-       3,13,4,
-       4,13,14,
-       4,14,5,
-       5,14,15,
-       5,15,6,
-       6,15,16,
-       6,16,7,
-       7,16,17,
-       7,17,8,
-       8,17,10,
-       8,10,1,
-
-
-    };
-
-    unsigned int circle_VBO, circle_VAO, circle_EBO;
-    glGenVertexArrays(1, &circle_VAO);
-    glGenBuffers(1, &circle_VBO);
-    glGenBuffers(1, &circle_EBO);
-
-    glBindVertexArray(circle_VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, circle_VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(circle_vertices5), circle_vertices5, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, circle_EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(circle_indices), circle_indices, GL_STATIC_DRAW);
-
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-
-    //color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-
-
-
-    unsigned int VBOCA, VAOCA, EBOCA;
-    glGenVertexArrays(1, &VAOCA);
-    glGenBuffers(1, &VBOCA);
-    glGenBuffers(1, &EBOCA);
-    glBindVertexArray(VAOCA);
-    glBindBuffer(GL_ARRAY_BUFFER, VBOCA);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(cabinate), cabinate, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOCA);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    //color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-    glEnableVertexAttribArray(1);
-
-    unsigned int VBOT, VAOT, EBOT;
-    glGenVertexArrays(1, &VAOT);
-    glGenBuffers(1, &VBOT);
-    glGenBuffers(1, &EBOT);
-    glBindVertexArray(VAOT);
-    glBindBuffer(GL_ARRAY_BUFFER, VBOT);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(ceiling), ceiling, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOT);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    //color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-    glEnableVertexAttribArray(1);
-
-
-    unsigned int VBO, VAO, EBO;
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(ac), ac, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    //color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-    glEnableVertexAttribArray(1);
-
-
-    unsigned int VBOG, VAOG, EBOG;
-    glGenVertexArrays(1, &VAOG);
-    glGenBuffers(1, &VBOG);
-    glGenBuffers(1, &EBOG);
-    glBindVertexArray(VAOG);
-    glBindBuffer(GL_ARRAY_BUFFER, VBOG);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(floor), floor, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOG);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    //color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-    glEnableVertexAttribArray(1);
-
-
-    unsigned int VBOW, VAOW, EBOW;
-    glGenVertexArrays(1, &VAOW);
-    glGenBuffers(1, &VBOW);
-    glGenBuffers(1, &EBOW);
-    glBindVertexArray(VAOW);
-    glBindBuffer(GL_ARRAY_BUFFER, VBOW);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(wall1), wall1, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOW);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    //color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-    glEnableVertexAttribArray(1);
-
-    unsigned int VBOW1, VAOW1, EBOW1;
-    glGenVertexArrays(1, &VAOW1);
-    glGenBuffers(1, &VBOW1);
-    glGenBuffers(1, &EBOW1);
-    glBindVertexArray(VAOW1);
-    glBindBuffer(GL_ARRAY_BUFFER, VBOW1);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(wall2), wall2, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOW1);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    //color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-    glEnableVertexAttribArray(1);
-
-
-    unsigned int VBOC, VAOC, EBOC;
-    glGenVertexArrays(1, &VAOC);
-    glGenBuffers(1, &VBOC);
-    glGenBuffers(1, &EBOC);
-    glBindVertexArray(VAOC);
-    glBindBuffer(GL_ARRAY_BUFFER, VBOC);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(box), box, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOC);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    //color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-    glEnableVertexAttribArray(1);
-
-
-    unsigned int VBOC2, VAOC2, EBOC2;
-    glGenVertexArrays(1, &VAOC2);
-    glGenBuffers(1, &VBOC2);
-    glGenBuffers(1, &EBOC2);
-    glBindVertexArray(VAOC2);
-    glBindBuffer(GL_ARRAY_BUFFER, VBOC2);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(box2), box2, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOC2);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    //color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-    glEnableVertexAttribArray(1);
-
-    //Fan
-    unsigned int VBOF1, VAOF1, EBOF1;
-    glGenVertexArrays(1, &VAOF1);
-    glGenBuffers(1, &VBOF1);
-    glGenBuffers(1, &EBOF1);
-    glBindVertexArray(VAOF1);
-    glBindBuffer(GL_ARRAY_BUFFER, VBOF1);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(fan_holder), fan_holder, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOF1);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    //color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-    glEnableVertexAttribArray(1);
-
-    unsigned int VBOF2, VAOF2, EBOF2;
-    glGenVertexArrays(1, &VAOF2);
-    glGenBuffers(1, &VBOF2);
-    glGenBuffers(1, &EBOF2);
-    glBindVertexArray(VAOF2);
-    glBindBuffer(GL_ARRAY_BUFFER, VBOF2);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(fan_pivot), fan_pivot, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOF2);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    //color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-    glEnableVertexAttribArray(1);
-
-    unsigned int VBOF3, VAOF3, EBOF3;
-    glGenVertexArrays(1, &VAOF3);
-    glGenBuffers(1, &VBOF3);
-    glGenBuffers(1, &EBOF3);
-    glBindVertexArray(VAOF3);
-    glBindBuffer(GL_ARRAY_BUFFER, VBOF3);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(fan_blade), fan_blade, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOF3);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    //color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-    glEnableVertexAttribArray(1);
-    int i = 0;
-
-    unsigned int VBOS, VAOS, EBOS;
-    glGenVertexArrays(1, &VAOS);
-    glGenBuffers(1, &VBOS);
-    glGenBuffers(1, &EBOS);
-    glBindVertexArray(VAOS);
-    glBindBuffer(GL_ARRAY_BUFFER, VBOS);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(glass), glass, GL_STATIC_DRAW);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBOS);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(cube_indices), cube_indices, GL_STATIC_DRAW);
-    // position attribute
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    //color attribute
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)12);
-    glEnableVertexAttribArray(1);
+    timestep.setRate(tickRate > 0.0 ? tickRate : 60.0);
 
+    // scene: read from a scene file, or the built-in bedroom (or a building of them) run
+    // through the same format
+    // -------------------------------------------------------------------------------------
+    SceneBuilder builder;
+    if (stress && scenePath == NULL)
+    {
+        StressSceneStats built = buildStressScene(builder, stressOptions);
+        // keep stdout clean when the benchmark JSON goes there
+        if (benchmarkFrames == 0 || benchmarkOutPath != NULL)
+            std::cout << "stress scene: " << built.rooms << " rooms, " << built.objects << " objects, " << built.spinningFans << " spinning fans" << std::endl;
+    }
+    else
+        buildBedroom(builder);
+    if (exportScenePath != NULL)
+    {
+        bool saved = builder.save(exportScenePath);
+        glfwTerminate();
+        return saved ? 0 : -1;
+    }
+
+    // shader sources and the scene file are read on worker threads; the render loop starts
+    // right away and picks them up as they arrive
+    // -------------------------------------------------------------------------------------
+    PendingAssets pending;
+    AssetLoader loader;
+    pending.shaderSources = loader.submit([&pending]() {
+        return Shader::readFile("vertexShader.vs", pending.vertexCode) && Shader::readFile("fragmentShader.fs", pending.fragmentCode);
+    });
+    pending.sceneSource = loader.submit([&pending, &builder, scenePath]() {
+        if (scenePath != NULL)
+            return pending.source.open(scenePath);
+        std::vector<unsigned char> bytes = builder.serialize();
+        return pending.source.open(bytes);
+    });
+
+    Shader ourShader;
+    // the frame's CPU work is spread over every core; this thread is one of them
+    JobSystem jobs(jobThreads);
+    FrameResources frame;
+    frame.jobs = &jobs;
+    frame.batch.setMultiDraw(multiDraw);
+    frame.lod.setTolerance(lodError);
+    frame.profiler.setEnabled(gpuProfile);
+    frame.occlusion.setEnabled(occlusionCulling);
+    // every world matrix is computed once when its object arrives; afterwards only nodes that move are recomputed
+    MaterialTable materials;
+    StaticScene scene;
+    LoadedScene loaded;
+    loaded.vertexFormat = vertexFormat;
+    loaded.mergeStatic = mergeStatic;
+    loaded.mergeChunkSize = mergeChunkSize;
+    Fan fan;
+    camera.SetProjection((float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+
+    if (benchmarkFrames > 0)
+    {
+        // frames are drawn while loading, as in the window, but only a fully loaded scene is measured
+        Clock::time_point firstFrame = contextReady;
+        for (int loadingFrame = 0; !pending.done(); loadingFrame++)
+        {
+            if (!continueLoading(pending, ourShader, programs, scene, materials, loaded, fan))
+            {
+                headless.destroy();
+                return -1;
+            }
+            headless.bindFramebuffer();
+            renderFrame(ourShader, frame, scene, materials, camera);
+            if (loadingFrame == 0)
+            {
+                glFinish();
+                firstFrame = Clock::now();
+            }
+        }
+
+        // fixed path and fan speed, so runs are comparable; the first frames warm up caches and the driver
+        std::ofstream benchmarkOut;
+        if (benchmarkOutPath != NULL)
+            benchmarkOut.open(benchmarkOutPath);
+        std::ostream& json = benchmarkOutPath != NULL ? benchmarkOut : std::cout;
+        int warmupFrames = std::min(benchmarkFrames, 30);
+        typedef std::chrono::duration<double, std::milli> Milliseconds;
+        StartupTimes startup;
+        startup.context = Milliseconds(contextReady - launched).count();
+        startup.firstFrame = Milliseconds(firstFrame - launched).count();
+        startup.shaders = Milliseconds(pending.shadersReady - launched).count();
+        startup.scene = Milliseconds(pending.sceneReady - launched).count();
+        startup.total = Milliseconds(std::max(pending.shadersReady, pending.sceneReady) - launched).count();
+        startup.programCache = !programs.isEnabled() ? "off" : programs.misses == 0 ? "hit" : "miss";
+        fan_turn = true;
+        previousState = currentState = captureState();
+        runFrameBenchmark(camera, bedroomFlythrough(), benchmarkFrames, warmupFrames, [&](int) {
+            // the path has already placed the camera; no keys are held, so the ticks only turn the fan
+            SimulationState shown = stepSimulation(BENCHMARK_FRAME_SECONDS);
+            JobSystem::Job* animation = jobs.create([&scene, &fan, shown]() { fan.local_rotation(scene, shown.fanAngle); });
+            jobs.submit(animation);
+            headless.bindFramebuffer();
+            renderFrame(ourShader, frame, scene, materials, camera, animation);
+        }, json, &frame.profiler, &startup);
+        if (benchmarkOutPath != NULL && !benchmarkOut)
+            std::cout << "ERROR::BENCHMARK::FILE_NOT_SUCCESSFULLY_WRITTEN" << std::endl;
+        frame.release();
+        loaded.release();
+        headless.destroy();
+        return 0;
+    }
 
+    bool loadFailed = false;
+    previousState = currentState = captureState();
 
+    pacer = FramePacer(pacing);
+    pacer.start(window);
+    std::ofstream latencyLog;
+    if (latencyLogPath != NULL)
+        latencyLog.open(latencyLogPath);
+    latency.setEnabled(measureLatency, latencyLogPath != NULL ? &latencyLog : NULL);
+    // the camera as drawn; it keeps its matrices between frames while the interpolated pose holds still
+    Camera viewer = camera;
 
     // render loop
     // -----------
     while (!glfwWindowShouldClose(window))
     {
+        // in low-latency mode, wait until the frame has to start; then take the newest input
+        // --------------------
+        pacer.waitForFrame();
+        glfwPollEvents();
+
         // per-frame time logic
         // --------------------
         float currentFrame = static_cast<float>(glfwGetTime());
@@ -860,288 +501,31 @@ int main()
         // -----
         processInput(window);
 
-        // render
+        // pick up whatever finished loading
         // ------
-        glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-
-        // activate shader
-        ourShader.use();
-        glm::mat4 model,rotate,scale;
-        // pass projection matrix to shader (note that in this case it could change every frame)
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        //glm::mat4 projection = glm::ortho(-2.0f, +2.0f, -1.5f, +1.5f, 0.1f, 100.0f);
-        ourShader.setMat4("projection", projection);
-
-        // camera/view transformation
-        glm::mat4 view = camera.GetViewMatrix();
-        //glm::mat4 view = basic_camera.createViewMatrix();
-        ourShader.setMat4("view", view);
-
-        
-
-
-        
-
-        
-
-        
-        //Floor
-
-        model = transforamtion(0, 0, 0, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 20, 0.1, 20);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOG);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        //Ceiling
-
-        model = transforamtion(0, 5, 0, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 20, 0.1, 20);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOT);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        //Wall1
-
-        model = transforamtion(0, 0, 0, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 20, 10, 0.1);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOW);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(0, 0, 10, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 20, 10, 0.1);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOW);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        //Wall2
-
-        model = transforamtion(10, 0, 0, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 0.1, 10, 20);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOW1);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        //Bed
-
-        model = transforamtion(10, 0, 3, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -7, 1.5, 6);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(10, 0, 3, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -1, 3.5, 6);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-        model = transforamtion(10, 0, 2.95, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -1, 3.5, .1);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOF2);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-        model = transforamtion(10, 0, 6, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -1, 3.5, .1);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOF2);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-        model = transforamtion(10, 1.75, 2.95, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -1, .1, 6.2);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOF2);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(6, 0, 3.75, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -3, 0.2, 3);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC2);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(9.5, 0.75, 3, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -6, 0.5, 6);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOW);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(9.5, 0.95, 3.25, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -2, .2, 2);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC2);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(9.5, 0.95, 4.75, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -2, .2, 2);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC2);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        //Table
-        model = transforamtion(10, 0.95, 7, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -4, .5, 5);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOF2);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(8.25, 0, 7, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -.5, 2, .5);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(10, 0, 7, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -.5, 2, .5);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(8.25, 0, 9.25, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -.5, 2, .5);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(10, 0, 9.25, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -.5, 2, .5);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-
-
-        //Chair
-        model = transforamtion(8.75, 0.5, 7.75, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -2, .5, 2);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOF2);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(8, 0, 7.75, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -.25, 1, .25);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(8, 0, 8.6, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -.25, 1, .25);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(8.75, 0, 8.6, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -.25, 1, .25);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(8.75, 0, 7.78, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -.25, 1, .25);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(7.82, 0.75, 7.82, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -.15, 1.65, .15);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(7.82, 0.75, 8.6, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -.15, 1.65, .15);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(7.80, 1.75, 7.75, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -.15, -1.5, 2);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOF2);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        //AC
-        model = transforamtion(10, 3, 4, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -5, 2, 6);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        //Cabinate
-        model = transforamtion(10, 0, 0, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -6, 4, 2);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOCA);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(10, 2, 0, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -6.115, .15, 2.115);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC2);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(10, 1.5, 0, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -6.115, .15, 2.115);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC2);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(10, 1, 0, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -6.115, .15, 2.115);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC2);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(10, .5, 0, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -6.115, .15, 2.115);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC2);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(10, 0, 0, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -6.115, .15, 2.115);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC2);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-
-        //Mirror
-        model = transforamtion(10, 0.5, 1.45, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -.15, 5, 2.5);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(9.98, 0.62, 1.58, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, -.17, 4.5, 2);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOF1);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        //Mirror
-        model = transforamtion(3, 1.5, 10, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 7, 5, -.15);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOC);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(3.15, 1.65, 10, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 2, 4.5, -.151);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOS);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(4.25, 1.65, 10, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 2, 4.5, -.151);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOS);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(5.35, 1.65, 10, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 2, 4.5, -.151);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOS);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-
-        //Lamp
-        model = transforamtion(6, 2, 0.5, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, 1,1,1);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(circle_VAO);
-        glDrawElements(GL_TRIANGLES, 96, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(6, 0, 0.5, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .15, 5, .15);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOF2);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-
-        model = transforamtion(5.95, 0, 0.35, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .6, .6, .6);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOF2);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-        
-
-
-
-        
-        
+        if (!pending.done() && !continueLoading(pending, ourShader, programs, scene, materials, loaded, fan))
+        {
+            loadFailed = true;
+            break;
+        }
 
-        //Fan
-        model = transforamtion(4.95, 3.45, 4.85, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .6, .6, .6);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOF1);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        // late latch: mouse motion that came in while loading still makes it into this frame's view
+        if (pacer.lateLatch())
+            glfwPollEvents();
 
-        model = transforamtion(4.95, 3.5, 4.95, rotateAngle_X, rotateAngle_Y, rotateAngle_Z, .15, 3, .15);
-        ourShader.setMat4("model", model);
-        glBindVertexArray(VAOF2);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        // simulate, then draw the state in between the last two ticks
+        // ------
+        SimulationState shown = stepSimulation(deltaTime);
+        viewer.SetPose(shown.cameraPosition, shown.cameraYaw, shown.cameraPitch, shown.cameraRoll);
+        viewer.SetZoom(camera.Zoom);
+        // the blades are turned on a job thread, the frame's scene update waits for it
+        JobSystem::Job* animation = jobs.create([&scene, &fan, shown]() { fan.local_rotation(scene, shown.fanAngle); });
+        jobs.submit(animation);
 
-        Fan fan;
-        ourShader = fan.local_rotation(ourShader, VAOF3, i);
+        // render
+        // ------
+        renderFrame(ourShader, frame, scene, materials, viewer, animation);
 
-        if (fan_turn)
-            i += 5;
         /*if (rotate_around)
             camera.ProcessKeyboard(Y_LEFT, deltaTime);*/
 
@@ -1161,20 +545,32 @@ int main()
 
 
         
+        pacer.beforeSwap();
         glfwSwapBuffers(window);
-        glfwPollEvents();
+        pacer.afterSwap();
+        latency.endFrame();
     }
 
     // optional: de-allocate all resources once they've outlived their purpose:
     // ------------------------------------------------------------------------
-    glDeleteVertexArrays(1, &VAO);
-    glDeleteBuffers(1, &VBO);
-    glDeleteBuffers(1, &EBO);
+    if (frame.profiler.isEnabled())
+    {
+        frame.profiler.finish();
+        frame.profiler.dump(std::cout);
+    }
+    if (latency.isEnabled())
+    {
+        latency.finish();
+        latency.dump(std::cout);
+    }
+    latency.release();
+    frame.release();
+    loaded.release();
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
-    return 0;
+    return loadFailed ? -1 : 0;
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
@@ -1184,42 +580,51 @@ void processInput(GLFWwindow* window)
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
+    // camera movement is applied by the simulation ticks, at a rate independent of the frame rate
+    for (bool& held : movement_held)
+        held = false;
+
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-        camera.ProcessKeyboard(FORWARD, deltaTime);
+        movement_held[FORWARD] = true;
     }
     if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
-        camera.ProcessKeyboard(BACKWARD, deltaTime);
+        movement_held[BACKWARD] = true;
     }
     if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS) {
-        camera.ProcessKeyboard(LEFT, deltaTime);
+        movement_held[LEFT] = true;
     }
     if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-        camera.ProcessKeyboard(RIGHT, deltaTime);
+        movement_held[RIGHT] = true;
     }
 
     if (glfwGetKey(window, GLFW_KEY_E) == GLFW_PRESS) {
-        camera.ProcessKeyboard(UP, deltaTime);
+        movement_held[UP] = true;
     }
     if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) {
-        camera.ProcessKeyboard(DOWN, deltaTime);
+        movement_held[DOWN] = true;
     }
     if (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS) {
-        camera.ProcessKeyboard(P_UP, deltaTime);
+        movement_held[P_UP] = true;
     }
     if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
-        camera.ProcessKeyboard(P_DOWN, deltaTime);
+        movement_held[P_DOWN] = true;
     }
     if (glfwGetKey(window, GLFW_KEY_Y) == GLFW_PRESS) {
-        camera.ProcessKeyboard(Y_LEFT, deltaTime);
+        movement_held[Y_LEFT] = true;
     }
     if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS) {
-        camera.ProcessKeyboard(Y_RIGHT, deltaTime);
+        movement_held[Y_RIGHT] = true;
     }
     if (glfwGetKey(window, GLFW_KEY_Z) == GLFW_PRESS) {
-        camera.ProcessKeyboard(R_LEFT, deltaTime);
+        movement_held[R_LEFT] = true;
     }
     if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
-        camera.ProcessKeyboard(R_RIGHT, deltaTime);
+        movement_held[R_RIGHT] = true;
+    }
+    for (bool held : movement_held)
+    {
+        if (held)
+            latency.inputArrived();
     }
     if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) {
         if (!fan_turn) {
@@ -1241,6 +646,342 @@ void processInput(GLFWwindow* window)
 
 }
 
+// one frame's share of loading: compile the program once its sources are read, link it when
+// the driver is done, stream the scene once it is parsed
+// ---------------------------------------------------------------------------------------------
+bool continueLoading(PendingAssets& pending, Shader& shader, ProgramCache& programs, StaticScene& scene, MaterialTable& materials, LoadedScene& loaded, Fan& fan)
+{
+    if (!pending.shaderStarted && isReady(pending.shaderSources))
+    {
+        if (!pending.shaderSources.get())
+            return false;
+        shader.compile(pending.vertexCode, pending.fragmentCode, &programs);
+        pending.shaderStarted = true;
+    }
+    // with KHR_parallel_shader_compile this waits for the driver's threads without blocking the frame
+    if (pending.shaderStarted && !pending.shaderDone && shader.isReady())
+    {
+        shader.finish();
+        modelUniform = shader.uniform<glm::mat4>("model");
+        materialColorUniform = shader.uniform<glm::vec4>("materialColor");
+        instancedUniform = shader.uniform<bool>("instanced");
+        pending.shaderDone = true;
+        pending.shadersReady = std::chrono::steady_clock::now();
+    }
+
+    if (!pending.sceneStarted && isReady(pending.sceneSource))
+    {
+        if (!pending.sceneSource.get())
+            return false;
+        pending.streamer.begin(pending.source.file, &pending.source.meshBounds, scene, materials, loaded);
+        pending.sceneStarted = true;
+    }
+    if (pending.sceneStarted && !pending.sceneDone)
+    {
+        pending.sceneDone = pending.streamer.step(UPLOAD_BYTES_PER_FRAME);
+        fan.spinners = loaded.spinners;
+        if (pending.sceneDone)
+        {
+            // vertex data is in GL buffers now, the file is no longer needed
+            pending.source.close();
+            pending.sceneReady = std::chrono::steady_clock::now();
+        }
+    }
+    return true;
+}
+
+// what the simulation owns, as it is right now
+// ---------------------------------------------------------------------------------------------
+SimulationState captureState()
+{
+    // input collected since the last capture (keys of the tick, mouse look) goes in first
+    camera.ApplyInput();
+    SimulationState state;
+    state.cameraPosition = camera.Position;
+    state.cameraYaw = camera.Yaw;
+    state.cameraPitch = camera.Pitch;
+    state.cameraRoll = camera.Roll;
+    state.fanAngle = fan_angle;
+    return state;
+}
+
+// one fixed tick: camera movement for the held keys, fan animation
+// ---------------------------------------------------------------------------------------------
+void simulateTick(float seconds)
+{
+    for (int movement = 0; movement <= R_RIGHT; movement++)
+    {
+        if (movement_held[movement])
+            camera.ProcessKeyboard((Camera_Movement)movement, seconds);
+    }
+    if (fan_turn)
+        fan_angle += FAN_SPEED * seconds;
+}
+
+// run the ticks a frame of that length pays for and return the state to draw
+// ---------------------------------------------------------------------------------------------
+SimulationState stepSimulation(double frameSeconds)
+{
+    int ticks = timestep.advance(frameSeconds);
+    for (int tick = 0; tick < ticks; tick++)
+    {
+        previousState = captureState();
+        simulateTick(timestep.step());
+        // keep the angle small; both states move so the interpolation does not spin back
+        if (fan_angle >= 360.0f)
+        {
+            fan_angle -= 360.0f;
+            previousState.fanAngle -= 360.0f;
+        }
+        currentState = captureState();
+    }
+    return interpolate(previousState, currentState, captureState(), timestep.alpha());
+}
+
+// add one object to the opaque queue given; translucent materials wait for the pass after every section
+// ---------------------------------------------------------------------------------------------
+void queueObject(const Shader& shader, FrameResources& frame, RenderQueue& opaque, const StaticScene& scene, const MaterialTable& materials, unsigned int object, unsigned int section)
+{
+    const SceneObject& sceneObject = scene.objects[object];
+    // round meshes come in levels of detail; far away objects draw fewer triangles
+    const Mesh& mesh = sceneObject.lod != NULL ? frame.lod.choose(*sceneObject.lod, scene.bounds[object]) : sceneObject.mesh;
+    RenderPass pass = materials.translucent(sceneObject.material) ? RENDER_TRANSLUCENT : RENDER_OPAQUE;
+    RenderQueue& queue = pass == RENDER_TRANSLUCENT ? frame.translucent : opaque;
+    queue.push(pass, shader.ID, mesh, sceneObject.material, scene.bounds[object], object, section);
+}
+
+// draw the sorted queue: through the instance batch, which keeps the order, when instanced_draw
+// is set, otherwise one at a time with only the state that changed set again. By section, the
+// queue was sorted by section and the draws of each section go inside its GPU timer when
+// profiling and inside its occlusion test's condition when conditional
+// ---------------------------------------------------------------------------------------------
+void drawQueue(Shader& shader, FrameResources& frame, const StaticScene& scene, const MaterialTable& materials, RenderQueue& queue, bool bySection, bool conditional)
+{
+    // a scene too large for the object buffer is drawn with per-object uniforms
+    bool instanced = instanced_draw && frame.objects.fits();
+    RenderState& state = frame.state;
+    state.reset();
+    GpuProfiler& profiler = frame.profiler;
+    const unsigned int noSection = 0xFFFFFFFFu;
+    unsigned int section = noSection;
+    for (const RenderPacket& packet : queue.sorted())
+    {
+        if (bySection && packet.group != section)
+        {
+            if (instanced)
+                frame.batch.flush(shader, instancedUniform);
+            if (section != noSection)
+            {
+                if (conditional)
+                    frame.occlusion.endConditional();
+                profiler.end();
+            }
+            section = packet.group;
+            profiler.begin(scene.sections.empty() ? "Scene" : scene.sections[section].name.c_str());
+            if (conditional)
+                frame.occlusion.beginConditional(section);
+        }
+        RenderPass pass = RenderQueue::passOf(packet.key);
+        if (pass != state.pass())
+        {
+            if (instanced)
+                frame.batch.flush(shader, instancedUniform);
+            state.setPass(pass);
+        }
+        if (instanced)
+        {
+            frame.batch.append(*packet.mesh, packet.object);
+            continue;
+        }
+        unsigned int material = scene.objects[packet.object].material;
+        if (state.changeMaterial(material))
+            shader.set(materialColorUniform, materials.rgba(material));
+        shader.set(modelUniform, dequantizedModel(scene.model(packet.object), packet.mesh->dequantization));
+        state.bindVertexArray(packet.mesh->VAO);
+        drawBoundMesh(*packet.mesh);
+    }
+    if (instanced)
+        frame.batch.flush(shader, instancedUniform);
+    if (section != noSection)
+    {
+        if (conditional)
+            frame.occlusion.endConditional();
+        profiler.end();
+    }
+    state.setPass(RENDER_OPAQUE);
+    queue.clear();
+}
+
+// queue the objects of a section that are in view
+// ------------------------------------------------
+void queueSection(const Shader& shader, FrameResources& frame, RenderQueue& opaque, const StaticScene& scene, const MaterialTable& materials, const SectionView& section, const std::vector<unsigned int>* visible)
+{
+    for (size_t i = section.begin; i < section.end; i++)
+        queueObject(shader, frame, opaque, scene, materials, visible != NULL ? (*visible)[i] : (unsigned int)i, section.section);
+}
+
+// the CPU side of the frame's draws, run as a job once culling is done: find the sections in
+// view, split them by last frame's occlusion results, then queue and sort their packets. Touches
+// no GL state; the occlusion culler's frame must have begun
+// ---------------------------------------------------------------------------------------------
+void queueFrame(const Shader& shader, FrameResources& frame, StaticScene& scene, const MaterialTable& materials, const glm::vec3& eye, const glm::mat4& viewProjection, const std::vector<unsigned int>* visible)
+{
+    // the rooms seen from the camera's room, through the windows and doors between them
+    bool portals = portal_culling && scene.portals.findVisible(eye, viewProjection);
+
+    // the sections with something in view; portal culling and the occlusion tests need the box around that
+    const OcclusionCuller& occlusion = frame.occlusion;
+    std::vector<SectionView>& inView = frame.sectionsInView;
+    inView.clear();
+    size_t next = 0;
+    unsigned int sectionCount = scene.sections.empty() ? 1 : (unsigned int)scene.sections.size();
+    for (unsigned int s = 0; s < sectionCount; s++)
+    {
+        unsigned int first = scene.sections.empty() ? 0 : scene.sections[s].firstObject;
+        unsigned int end = scene.sections.empty() ? (unsigned int)scene.size() : first + scene.sections[s].objectCount;
+        SectionView section;
+        section.section = s;
+        if (visible != NULL)
+        {
+            while (next < visible->size() && (*visible)[next] < first)
+                next++;
+            section.begin = next;
+            while (next < visible->size() && (*visible)[next] < end)
+                next++;
+            section.end = next;
+        }
+        else
+        {
+            section.begin = first;
+            section.end = end;
+        }
+        if (section.begin == section.end)
+            continue;
+        if (occlusion.isEnabled() || portals)
+        {
+            for (size_t i = section.begin; i < section.end; i++)
+                section.box.grow(scene.bounds[visible != NULL ? (*visible)[i] : (unsigned int)i]);
+        }
+        if (portals && !scene.portals.boxVisible(section.box))
+            continue;
+        section.drawFirst = occlusion.drawFirst(section.section, section.box);
+        inView.push_back(section);
+    }
+
+    // the sections seen last frame go first and hide the rest. With the profiler on, they are
+    // sorted by section, so every section is one timed, labelled range of the queue; the rest
+    // always are, as each section is drawn under its own condition
+    for (const SectionView& section : inView)
+    {
+        if (section.drawFirst)
+            queueSection(shader, frame, frame.queue, scene, materials, section, visible);
+    }
+    for (const SectionView& section : inView)
+    {
+        if (!section.drawFirst)
+            queueSection(shader, frame, frame.later, scene, materials, section, visible);
+    }
+    frame.queue.sort(frame.profiler.isEnabled());
+    frame.later.sort(true);
+    frame.translucent.sort(false);
+}
+
+// draw the scene as seen from the camera
+// ---------------------------------------
+void renderFrame(Shader& shader, FrameResources& frame, StaticScene& scene, const MaterialTable& materials, Camera& viewer, JobSystem::Job* animation)
+{
+    GpuProfiler& profiler = frame.profiler;
+    profiler.beginFrame();
+
+    glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    JobSystem& jobs = *frame.jobs;
+    // still compiling: an empty frame keeps the window responsive
+    if (!shader.isLinked())
+    {
+        if (animation != NULL)
+            jobs.wait(animation);
+        jobs.reset();
+        return;
+    }
+
+    // the CPU work runs as jobs while this thread talks to GL: first the animation, then the
+    // world matrices and boxes of what moved; after that, filling the object buffer and culling
+    // side by side, and once culling is done, queueing and sorting the draws. Each of them
+    // splits further over the threads when there is enough to do. The camera is read here,
+    // before any job starts.
+    const Frustum& frustum = viewer.GetFrustum();
+    const std::vector<unsigned int>* visible = NULL;
+    JobSystem::Job* transforms = jobs.create([&]() { scene.update(&jobs); });
+    JobSystem::Job* objects = jobs.create([&]() { frame.objects.prepare(scene, materials, scene.movedObjects(), &jobs); });
+    // only objects whose box touches the view frustum are submitted; the list is in object order
+    JobSystem::Job* culling = jobs.create([&]() {
+        if (frustum_culling)
+            visible = &scene.cull(frustum, &jobs);
+    });
+    if (animation != NULL)
+        jobs.addDependency(transforms, animation);
+    jobs.addDependency(objects, transforms);
+    jobs.addDependency(culling, transforms);
+    jobs.submit(transforms);
+    jobs.submit(objects);
+    jobs.submit(culling);
+
+    // activate shader
+    shader.use();
+    // projection matrix (note that in this case it could change every frame)
+    const glm::mat4& projection = viewer.GetProjectionMatrix();
+    //glm::mat4 projection = glm::ortho(-2.0f, +2.0f, -1.5f, +1.5f, 0.1f, 100.0f);
+
+    // camera/view transformation
+    const glm::mat4& view = viewer.GetViewMatrix();
+    //glm::mat4 view = basic_camera.createViewMatrix();
+
+    // one buffer update carries the camera to every program
+    const glm::mat4& viewProjection = viewer.GetViewProjectionMatrix();
+    frame.camera.update(view, projection, viewProjection);
+    frame.lod.setView(viewer.Position, projection, (float)viewport_height);
+    frame.queue.setView(view);
+    frame.later.setView(view);
+    frame.translucent.setView(view);
+
+    // last frame's test results come in through GL, so the queueing job starts after that
+    OcclusionCuller& occlusion = frame.occlusion;
+    if (occlusion.isEnabled())
+        occlusion.beginFrame(scene.sections.empty() ? 1 : scene.sections.size(), viewer.Position, viewer.GetNear());
+    JobSystem::Job* packets = jobs.create([&]() { queueFrame(shader, frame, scene, materials, viewer.Position, viewProjection, visible); });
+    jobs.addDependency(packets, culling);
+    jobs.submit(packets);
+
+    jobs.wait(objects);
+    frame.objects.upload();
+    frame.objects.bind();
+    jobs.wait(packets);
+    // every job of the frame is done (the others come before these two)
+    jobs.reset();
+
+    drawQueue(shader, frame, scene, materials, frame.queue, profiler.isEnabled(), false);
+
+    // then the box of every section is tested against that depth: the results tell the next
+    // frame what to draw first, and this frame whether the rest is drawn at all
+    if (occlusion.isEnabled())
+    {
+        occlusion.beginTests(shader, modelUniform);
+        for (const SectionView& section : frame.sectionsInView)
+            occlusion.test(section.section, section.box);
+        occlusion.endTests();
+        drawQueue(shader, frame, scene, materials, frame.later, true, true);
+    }
+
+    // glass last, back to front over everything opaque of every section. It is not drawn under
+    // the occlusion conditions: sections interleave in depth here, and hidden glass fails the
+    // depth test anyway
+    profiler.begin("Translucent");
+    drawQueue(shader, frame, scene, materials, frame.translucent, false, false);
+    profiler.end();
+}
+
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
 // ---------------------------------------------------------------------------------------------
 void framebuffer_size_callback(GLFWwindow* window, int width, int height)
@@ -1248,6 +989,8 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
     // make sure the viewport matches the new window dimensions; note that width and
     // height will be significantly larger than specified on retina displays.
     glViewport(0, 0, width, height);
+    if (height > 0)
+        viewport_height = (unsigned int)height;
 }
 
 
@@ -1272,6 +1015,7 @@ void mouse_callback(GLFWwindow* window, double xposIn, double yposIn)
     lastY = ypos;
 
     camera.ProcessMouseMovement(xoffset, yoffset);
+    latency.inputArrived();
 }
 
 // glfw: whenever the mouse scroll wheel scrolls, this callback is called
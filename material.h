@@ -0,0 +1,73 @@
+//
+//  material.h
+//  3D Object Drawing
+//
+//  Named furniture colors. A material is an index into the table; its color
+//  tints the mesh's vertex colors, so one white cube serves every piece.
+//  A material with an opacity below 1 is translucent, like the window glass,
+//  and is blended over what is behind it.
+//
+
+#ifndef MATERIAL_H
+#define MATERIAL_H
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+struct Material
+{
+    std::string name;
+    glm::vec3 color;
+    // 1 is opaque
+    float opacity;
+};
+
+class MaterialTable
+{
+public:
+    std::vector<Material> materials;
+
+    // returns the index of the new material
+    unsigned int add(const std::string& name, const glm::vec3& color, float opacity = 1.0f)
+    {
+        Material material;
+        material.name = name;
+        material.color = color;
+        material.opacity = opacity;
+        materials.push_back(material);
+        return (unsigned int)materials.size() - 1;
+    }
+
+    // index of the material with that name, or -1
+    int find(const std::string& name) const
+    {
+        for (size_t i = 0; i < materials.size(); i++)
+        {
+            if (materials[i].name == name)
+                return (int)i;
+        }
+        return -1;
+    }
+
+    const glm::vec3& color(unsigned int index) const
+    {
+        return materials[index].color;
+    }
+
+    // color and opacity, as the shader takes them
+    glm::vec4 rgba(unsigned int index) const
+    {
+        return glm::vec4(materials[index].color, materials[index].opacity);
+    }
+
+    bool translucent(unsigned int index) const
+    {
+        return materials[index].opacity < 1.0f;
+    }
+
+    size_t size() const { return materials.size(); }
+};
+
+#endif
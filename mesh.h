@@ -0,0 +1,92 @@
+//
+//  mesh.h
+//  3D Object Drawing
+//
+//  GPU buffers of one indexed mesh. Meshes are given as position (location 0)
+//  followed by color (location 1), six floats per vertex; in the buffers they
+//  may be packed smaller (see vertex_format.h), with the dequantization kept
+//  here. The bounding box of the positions is kept for culling. A mesh may be
+//  a range of shared buffers (see geometry_pool.h): it then starts at
+//  firstIndex, counted in indices of its indexType, and its indices are
+//  relative to baseVertex.
+//
+
+#ifndef MESH_H
+#define MESH_H
+
+#include <glad/glad.h>
+
+#include "bounds.h"
+#include "vertex_format.h"
+
+#include <cstddef>
+
+// bytes per vertex as meshes are given: position and color, three floats each
+const size_t MESH_VERTEX_SIZE = 6 * sizeof(float);
+
+struct Mesh
+{
+    unsigned int VAO;
+    unsigned int VBO;
+    unsigned int EBO;
+    unsigned int indexCount;
+    unsigned int firstIndex;
+    int baseVertex;
+    GLenum indexType;
+    // in model space
+    AABB bounds;
+    // from the stored positions to model space; fold into the model matrix with dequantizedModel()
+    PositionDequantization dequantization;
+
+    Mesh() : VAO(0), VBO(0), EBO(0), indexCount(0), firstIndex(0), baseVertex(0), indexType(GL_UNSIGNED_INT) {}
+};
+
+inline AABB meshBounds(const float* vertices, size_t verticesSize)
+{
+    AABB bounds;
+    for (size_t i = 0; i < verticesSize / sizeof(float); i += 6)
+        bounds.grow(glm::vec3(vertices[i], vertices[i + 1], vertices[i + 2]));
+    return bounds;
+}
+
+// upload vertices/indices and configure the position and color attributes
+inline Mesh createMesh(const float* vertices, size_t verticesSize, const unsigned int* indices, size_t indicesSize)
+{
+    Mesh mesh;
+    mesh.indexCount = (unsigned int)(indicesSize / sizeof(unsigned int));
+    mesh.bounds = meshBounds(vertices, verticesSize);
+    glGenVertexArrays(1, &mesh.VAO);
+    glGenBuffers(1, &mesh.VBO);
+    glGenBuffers(1, &mesh.EBO);
+    glBindVertexArray(mesh.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    glBufferData(GL_ARRAY_BUFFER, verticesSize, vertices, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indicesSize, indices, GL_STATIC_DRAW);
+    applyVertexLayout(vertexLayout(VERTEX_FLOAT));
+    return mesh;
+}
+
+// only for meshes made by createMesh; pooled meshes are freed with their pool
+inline void deleteMesh(Mesh& mesh)
+{
+    glDeleteVertexArrays(1, &mesh.VAO);
+    glDeleteBuffers(1, &mesh.VBO);
+    glDeleteBuffers(1, &mesh.EBO);
+    mesh = Mesh();
+}
+
+// draw one mesh whose VAO is already bound
+inline void drawBoundMesh(const Mesh& mesh)
+{
+    glDrawElementsBaseVertex(GL_TRIANGLES, mesh.indexCount, mesh.indexType, (void*)(mesh.firstIndex * indexSize(mesh.indexType)), mesh.baseVertex);
+}
+
+// draw one mesh with the current program and uniforms
+inline void drawMesh(const Mesh& mesh)
+{
+    glBindVertexArray(mesh.VAO);
+    drawBoundMesh(mesh);
+}
+
+#endif
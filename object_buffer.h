@@ -0,0 +1,240 @@
+//
+//  object_buffer.h
+//  3D Object Drawing
+//
+//  Model matrix and color of every scene object in one texture buffer, read
+//  in the vertex shader with texelFetch from the samplerBuffer "objects".
+//  Object i occupies texels 5i..5i+4: the four matrix columns, then the color
+//  with the material's opacity in alpha.
+//  The matrix includes the dequantization of the object's mesh (vertex_format.h).
+//  Objects with a world pose have their matrices built by the batch composer
+//  (transform_batch.h) straight into the texels, with the dequantization
+//  folded into the pose; the others copy their world matrix.
+//  Every object is uploaded once when it joins the scene; afterwards only
+//  objects that moved are rewritten, so a frame sends object indices instead
+//  of matrices. prepare() does the CPU side and may run on a job thread;
+//  upload() sends the result from the context thread. A scene with more
+//  objects than GL_MAX_TEXTURE_BUFFER_SIZE holds does not fit; the caller
+//  then draws with the per-object uniforms instead.
+//
+
+#ifndef OBJECT_BUFFER_H
+#define OBJECT_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "job_system.h"
+#include "material.h"
+#include "shader.h"
+#include "static_scene.h"
+#include "transform_batch.h"
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+class ObjectBuffer
+{
+public:
+    static const unsigned int TEXELS_PER_OBJECT = 5;
+
+    ObjectBuffer() : TBO(0), texture(0), capacity(0), maxObjects(0), overflowed(false)
+    {
+    }
+
+    // write objects added since the last call and the objects that moved; consecutive
+    // objects go up in one call. The buffer grows as a streamed scene comes in.
+    void update(const StaticScene& scene, const MaterialTable& materials, const std::vector<unsigned int>& moved)
+    {
+        prepare(scene, materials, moved);
+        upload();
+    }
+
+    // the CPU half of update(): fill the texels and note the ranges to send. Touches no GL
+    // state, so it can run on a job thread; with jobs, the texels are written in parallel.
+    void prepare(const StaticScene& scene, const MaterialTable& materials, const std::vector<unsigned int>& moved, JobSystem* jobs = NULL)
+    {
+        ranges.clear();
+        size_t written = texels.size() / TEXELS_PER_OBJECT;
+        if (scene.size() > written)
+        {
+            texels.resize(scene.size() * TEXELS_PER_OBJECT);
+            writeObjects(scene, materials, NULL, written, scene.size(), jobs);
+            ranges.push_back(Range(written, scene.size() - written));
+        }
+        if (moved.empty())
+            return;
+        sorted.assign(moved.begin(), moved.end());
+        std::sort(sorted.begin(), sorted.end());
+        writeObjects(scene, materials, &sorted, 0, sorted.size(), jobs);
+        size_t first = 0;
+        while (first < sorted.size())
+        {
+            size_t end = first + 1;
+            while (end < sorted.size() && sorted[end] <= sorted[end - 1] + 1)
+                end++;
+            ranges.push_back(Range(sorted[first], sorted[end - 1] - sorted[first] + 1));
+            first = end;
+        }
+    }
+
+    // the GL half: grow the buffer if the scene outgrew it and send what prepare() wrote
+    void upload()
+    {
+        size_t objects = texels.size() / TEXELS_PER_OBJECT;
+        if (objects > capacity)
+        {
+            if (maxObjects == 0)
+            {
+                GLint maxTexels = 0;
+                glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+                maxObjects = (size_t)maxTexels / TEXELS_PER_OBJECT;
+            }
+            if (objects > maxObjects)
+            {
+                if (!overflowed)
+                    std::cout << "ERROR::OBJECT_BUFFER::TOO_MANY_OBJECTS: " << objects << " objects, room for " << maxObjects << std::endl;
+                overflowed = true;
+                ranges.clear();
+                return;
+            }
+            allocate(std::min(std::max(objects, capacity * 2), maxObjects));
+            // new storage: everything goes up again
+            ranges.clear();
+            ranges.push_back(Range(0, objects));
+        }
+        for (const Range& range : ranges)
+            upload(range.first, range.count);
+        ranges.clear();
+    }
+
+    // false once the scene has more objects than a texture buffer can hold; nothing is uploaded then
+    bool fits() const { return !overflowed; }
+
+    void bind() const
+    {
+        glActiveTexture(GL_TEXTURE0 + OBJECT_BUFFER_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+    }
+
+    // must run while the GL context is still current
+    void release()
+    {
+        if (texture != 0)
+            glDeleteTextures(1, &texture);
+        if (TBO != 0)
+            glDeleteBuffers(1, &TBO);
+        texture = TBO = 0;
+        capacity = 0;
+        overflowed = false;
+        texels.clear();
+    }
+
+private:
+    unsigned int TBO;
+    unsigned int texture;
+    // objects the buffer has room for, and the most any texture buffer has
+    size_t capacity, maxObjects;
+    bool overflowed;
+    // CPU copy, so partial updates can be sent from contiguous memory
+    std::vector<glm::vec4> texels;
+    std::vector<unsigned int> sorted;
+    // poses waiting for the composer, one batch per piece of writeObjects()
+    std::vector<TransformBatch> batches;
+    // objects written by prepare() and not yet uploaded
+    struct Range
+    {
+        size_t first, count;
+        Range(size_t first, size_t count) : first(first), count(count) {}
+    };
+    std::vector<Range> ranges;
+
+    // new storage for at least that many objects; the caller uploads everything again
+    void allocate(size_t objects)
+    {
+        capacity = objects;
+        if (TBO == 0)
+            glGenBuffers(1, &TBO);
+        glBindBuffer(GL_TEXTURE_BUFFER, TBO);
+        glBufferData(GL_TEXTURE_BUFFER, capacity * TEXELS_PER_OBJECT * sizeof(glm::vec4), NULL, GL_DYNAMIC_DRAW);
+        if (texture == 0)
+            glGenTextures(1, &texture);
+        // re-attach, the texture has to see the new storage
+        glBindTexture(GL_TEXTURE_BUFFER, texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, TBO);
+    }
+
+    void upload(size_t firstObject, size_t objectCount)
+    {
+        size_t firstTexel = firstObject * TEXELS_PER_OBJECT;
+        glBindBuffer(GL_TEXTURE_BUFFER, TBO);
+        glBufferSubData(GL_TEXTURE_BUFFER, firstTexel * sizeof(glm::vec4), objectCount * TEXELS_PER_OBJECT * sizeof(glm::vec4), &texels[firstTexel]);
+    }
+
+    // objects first..end-1, or the objects list[first..end-1]
+    void writeObjects(const StaticScene& scene, const MaterialTable& materials, const std::vector<unsigned int>* list, size_t first, size_t end, JobSystem* jobs)
+    {
+        if (end == first)
+            return;
+        size_t grain = jobs != NULL ? jobs->grainFor(end - first, StaticScene::PARALLEL_GRAIN) : end - first;
+        // parallelFor splits at multiples of the grain, so each piece owns one batch
+        size_t pieces = (end - first + grain - 1) / grain;
+        if (batches.size() < pieces)
+            batches.resize(pieces, TransformBatch(true));
+        std::function<void(size_t, size_t)> body = [&](size_t from, size_t to) {
+            TransformBatch& batch = batches[from / grain];
+            batch.clear();
+            // consecutive posed objects are composed together, starting at runStart
+            size_t runStart = 0;
+            for (size_t i = first + from; i < first + to; i++)
+            {
+                unsigned int object = list != NULL ? (*list)[i] : (unsigned int)i;
+                const Pose* pose = scene.worldPose(object);
+                if (batch.size() > 0 && (pose == NULL || object != runStart + batch.size()))
+                    compose(batch, runStart);
+                if (pose != NULL)
+                {
+                    if (batch.size() == 0)
+                        runStart = object;
+                    addPose(batch, *pose, scene.objects[object].mesh.dequantization);
+                }
+                else
+                    writeModel(scene, object);
+                texels[object * TEXELS_PER_OBJECT + 4] = materials.rgba(scene.objects[object].material);
+            }
+            if (batch.size() > 0)
+                compose(batch, runStart);
+        };
+        if (jobs != NULL)
+            jobs->parallelFor(end - first, grain, body);
+        else
+            body(0, end - first);
+    }
+
+    // compact meshes store positions inside their box: T R S * T(offset) S(box scale) is
+    // T(t + R(S offset)) R S(S box scale), so the dequantization folds into the pose
+    static void addPose(TransformBatch& batch, const Pose& pose, const PositionDequantization& dequantization)
+    {
+        batch.add(pose.translation + pose.rotation * (pose.scale * dequantization.offset), pose.rotation, pose.scale * dequantization.scale);
+    }
+
+    // matrix columns of objects firstObject.. from the batch, written in place
+    void compose(TransformBatch& batch, size_t firstObject)
+    {
+        composeTransforms(batch, &texels[firstObject * TEXELS_PER_OBJECT].x, TEXELS_PER_OBJECT * 4);
+        batch.clear();
+    }
+
+    // objects placed by matrix (merged chunks, sheared children) copy the world matrix
+    void writeModel(const StaticScene& scene, unsigned int object)
+    {
+        glm::mat4 model = dequantizedModel(scene.model(object), scene.objects[object].mesh.dequantization);
+        glm::vec4* texel = &texels[object * TEXELS_PER_OBJECT];
+        for (int column = 0; column < 4; column++)
+            texel[column] = model[column];
+    }
+};
+
+#endif
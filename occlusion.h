@@ -0,0 +1,217 @@
+//
+//  occlusion.h
+//  3D Object Drawing
+//
+//  Occlusion culling per scene section (a piece of furniture, or a chunk of
+//  merged static geometry) with hardware queries. The sections that were
+//  visible in the last frame are drawn first: they are the walls, beds and
+//  cabinets in front of everything else. Then the box of every section in
+//  the frustum is drawn into a GL_ANY_SAMPLES_PASSED query, without writing
+//  color or depth, and the sections that were hidden last frame are drawn
+//  inside glBeginConditionalRender on their query, so the GPU drops them
+//  when no sample of their box got through. The queries of a frame decide
+//  which sections go first in the next one; their results are only read
+//  once the driver has them, so the CPU never waits. A section the camera
+//  is inside of, or one that just came into view, always goes first.
+//
+
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+#include "shader.h"
+
+#include <vector>
+
+// boxes grow by this much plus a hundredth of their size, so geometry on a box face never hides the box
+const float OCCLUSION_BOX_MARGIN = 0.02f;
+
+class OcclusionCuller
+{
+public:
+    OcclusionCuller() : enabled(true), frame(0), eye(0.0f), nearPlane(0.0f), boxVAO(0), boxVBO(0), boxEBO(0), testShader(NULL), lastConditional(0), conditional(0)
+    {
+    }
+
+    void setEnabled(bool on) { enabled = on; }
+    bool isEnabled() const { return enabled; }
+
+    // once per frame, before any section is drawn: take in the results of last frame's tests that have arrived
+    void beginFrame(size_t sectionCount, const glm::vec3& cameraPosition, float cameraNear)
+    {
+        eye = cameraPosition;
+        nearPlane = cameraNear;
+        if (sections.size() < sectionCount)
+            sections.resize(sectionCount);
+        lastConditional = conditional;
+        conditional = 0;
+        unsigned int previous = frame & 1;
+        for (SectionState& section : sections)
+        {
+            // a section not tested last frame is either new or just came into view
+            if (section.testedFrame != frame || frame == 0)
+            {
+                section.visible = true;
+                continue;
+            }
+            GLuint available = 0;
+            glGetQueryObjectuiv(section.queries[previous], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available)
+                continue;
+            GLuint samples = 0;
+            glGetQueryObjectuiv(section.queries[previous], GL_QUERY_RESULT, &samples);
+            section.visible = samples != 0;
+        }
+        frame++;
+    }
+
+    // whether the section is drawn in the first pass, unconditionally
+    bool drawFirst(unsigned int section, const AABB& box) const
+    {
+        if (!enabled || section >= sections.size() || sections[section].visible)
+            return true;
+        // the near plane would cut away the faces of a box around the camera
+        AABB around = inflate(box, nearPlane * 2.0f);
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (eye[axis] < around.min[axis] || eye[axis] > around.max[axis])
+                return false;
+        }
+        return true;
+    }
+
+    // the tests: draw every box with the program whose model matrix uniform is given; no color or depth is written
+    void beginTests(const Shader& shader, Uniform<glm::mat4> model)
+    {
+        if (boxVAO == 0)
+            createBox();
+        testShader = &shader;
+        modelUniform = model;
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        // a box face lying on drawn geometry still counts
+        glDepthFunc(GL_LEQUAL);
+        glBindVertexArray(boxVAO);
+    }
+
+    // query whether any sample of the section's box is in front of what is drawn
+    void test(unsigned int section, const AABB& box)
+    {
+        SectionState& state = sections[section];
+        if (state.queries[0] == 0)
+            glGenQueries(2, state.queries);
+        AABB grown = inflate(box, 0.0f);
+        glm::mat4 model(1.0f);
+        model[0][0] = grown.max.x - grown.min.x;
+        model[1][1] = grown.max.y - grown.min.y;
+        model[2][2] = grown.max.z - grown.min.z;
+        model[3] = glm::vec4(grown.min, 1.0f);
+        testShader->set(modelUniform, model);
+        glBeginQuery(GL_ANY_SAMPLES_PASSED, state.queries[frame & 1]);
+        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_BYTE, (void*)0);
+        glEndQuery(GL_ANY_SAMPLES_PASSED);
+        state.testedFrame = frame;
+    }
+
+    void endTests()
+    {
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+    }
+
+    // draws up to endConditional() only happen if the section's box passed this frame's test;
+    // the GPU waits for the query, the CPU does not
+    void beginConditional(unsigned int section)
+    {
+        glBeginConditionalRender(sections[section].queries[frame & 1], GL_QUERY_WAIT);
+        conditional++;
+    }
+
+    void endConditional()
+    {
+        glEndConditionalRender();
+    }
+
+    // sections that were hidden last frame and drawn under a condition in the last complete frame
+    unsigned int conditionalSections() const { return lastConditional; }
+
+    // must run while the GL context is still current
+    void release()
+    {
+        for (SectionState& section : sections)
+        {
+            if (section.queries[0] != 0)
+                glDeleteQueries(2, section.queries);
+        }
+        sections.clear();
+        if (boxVAO != 0)
+        {
+            glDeleteVertexArrays(1, &boxVAO);
+            glDeleteBuffers(1, &boxVBO);
+            glDeleteBuffers(1, &boxEBO);
+        }
+        boxVAO = boxVBO = boxEBO = 0;
+    }
+
+private:
+    struct SectionState
+    {
+        // this frame's and last frame's test
+        GLuint queries[2];
+        // frame whose query slot holds the last test
+        unsigned int testedFrame;
+        bool visible;
+
+        SectionState() : testedFrame(0), visible(true)
+        {
+            queries[0] = queries[1] = 0;
+        }
+    };
+
+    bool enabled;
+    // counts from 1 once the first frame has begun; tests of frame f use query slot f & 1
+    unsigned int frame;
+    glm::vec3 eye;
+    float nearPlane;
+    std::vector<SectionState> sections;
+    // unit cube from 0 to 1, positions only
+    unsigned int boxVAO, boxVBO, boxEBO;
+    const Shader* testShader;
+    Uniform<glm::mat4> modelUniform;
+    unsigned int lastConditional, conditional;
+
+    static AABB inflate(const AABB& box, float extra)
+    {
+        glm::vec3 margin = (box.max - box.min) * 0.01f + glm::vec3(OCCLUSION_BOX_MARGIN + extra);
+        return AABB(box.min - margin, box.max + margin);
+    }
+
+    void createBox()
+    {
+        const float corners[] = {
+            0, 0, 0,  1, 0, 0,  1, 1, 0,  0, 1, 0,
+            0, 0, 1,  1, 0, 1,  1, 1, 1,  0, 1, 1
+        };
+        const unsigned char faces[] = {
+            0, 1, 2, 2, 3, 0,   4, 6, 5, 6, 4, 7,
+            0, 4, 5, 5, 1, 0,   3, 2, 6, 6, 7, 3,
+            0, 3, 7, 7, 4, 0,   1, 5, 6, 6, 2, 1
+        };
+        glGenVertexArrays(1, &boxVAO);
+        glGenBuffers(1, &boxVBO);
+        glGenBuffers(1, &boxEBO);
+        glBindVertexArray(boxVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, boxVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, boxEBO);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(faces), faces, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+    }
+};
+
+#endif
@@ -0,0 +1,351 @@
+//
+//  portals.h
+//  3D Object Drawing
+//
+//  Cell and portal visibility. Rooms are cells, windows and doors are
+//  portals, all given as world-space boxes; a portal joins the cells its box
+//  touches. Every frame the cells are walked from the one the camera is in:
+//  the box of each portal of a cell is projected to the screen and clipped
+//  to the part of the screen the cell was seen through, and the cells on the
+//  other side are visited with what is left. Only cells reached that way are
+//  drawn. Nothing about visibility is stored between frames; cells and
+//  portals sit in a hash grid, so which portals a cell has is looked up as
+//  it is walked and boxes can be added or moved at any time.
+//
+
+#ifndef PORTALS_H
+#define PORTALS_H
+
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// edge of a hash grid cell in world units: a room of the bedroom
+const float PORTAL_GRID_SIZE = 10.0f;
+// a portal joins cells its box comes this close to
+const float PORTAL_TOUCH_MARGIN = 0.01f;
+// rooms side by side share a wall, so their boxes overlap by its thickness (0.05 in the
+// bedroom); what reaches no deeper than this into a room is inside that wall, not in the room
+const float PORTAL_WALL_THICKNESS = 0.1f;
+// portals seen through portals seen through ... this many times at most
+const unsigned int PORTAL_MAX_DEPTH = 32;
+// a box spread over more hash grid cells than this is always visible, rather than checked room by room
+const unsigned int PORTAL_MAX_BOX_KEYS = 64;
+
+// part of the screen in normalized device coordinates
+struct ScreenRect
+{
+    glm::vec2 min, max;
+
+    ScreenRect() : min(-1.0f), max(1.0f) {}
+    ScreenRect(const glm::vec2& lo, const glm::vec2& hi) : min(lo), max(hi) {}
+
+    bool empty() const { return min.x >= max.x || min.y >= max.y; }
+    bool contains(const ScreenRect& other) const
+    {
+        return other.min.x >= min.x && other.min.y >= min.y && other.max.x <= max.x && other.max.y <= max.y;
+    }
+};
+
+class PortalVisibility
+{
+public:
+    PortalVisibility() : frame(0), visibleCount(0), viewProjection(1.0f)
+    {
+    }
+
+    void clear()
+    {
+        cells.clear();
+        portals.clear();
+        cellGrid.clear();
+        portalGrid.clear();
+    }
+
+    // a room; returns its index
+    unsigned int addCell(const AABB& box)
+    {
+        cells.push_back(Cell());
+        cells.back().box = box;
+        unsigned int index = (unsigned int)cells.size() - 1;
+        insert(cellGrid, box, index);
+        return index;
+    }
+
+    // an opening between the cells its box touches; returns its index
+    unsigned int addPortal(const AABB& box)
+    {
+        portals.push_back(box);
+        unsigned int index = (unsigned int)portals.size() - 1;
+        insert(portalGrid, box, index);
+        return index;
+    }
+
+    void moveCell(unsigned int index, const AABB& box)
+    {
+        erase(cellGrid, cells[index].box, index);
+        cells[index].box = box;
+        insert(cellGrid, box, index);
+    }
+
+    void movePortal(unsigned int index, const AABB& box)
+    {
+        erase(portalGrid, portals[index], index);
+        portals[index] = box;
+        insert(portalGrid, box, index);
+    }
+
+    size_t cellCount() const { return cells.size(); }
+    size_t portalCount() const { return portals.size(); }
+
+    // walk the cells seen from the eye; false when the eye is in no cell, and everything counts as visible
+    bool findVisible(const glm::vec3& eye, const glm::mat4& viewProjection)
+    {
+        frame++;
+        visibleCount = 0;
+        this->viewProjection = viewProjection;
+        // inside a wall two cells overlap; the walk starts from all of them
+        bool inside = false;
+        lookup(cellGrid, AABB(eye, eye), roots);
+        for (unsigned int cell : roots)
+        {
+            const AABB& box = cells[cell].box;
+            if (eye.x < box.min.x || eye.y < box.min.y || eye.z < box.min.z || eye.x > box.max.x || eye.y > box.max.y || eye.z > box.max.z)
+                continue;
+            inside = true;
+            visit(cell, ScreenRect(), 0);
+        }
+        return inside;
+    }
+
+    // whether a box may be seen after the last findVisible(): it reaches past the walls into a
+    // cell that was reached, or some of it is outside every cell, such as furniture poking through a wall. A box over
+    // several rooms, like a chunk of merged furniture two storeys high, is hidden once all of
+    // them are.
+    bool boxVisible(const AABB& box)
+    {
+        if (box.empty() || keyCount(box) > PORTAL_MAX_BOX_KEYS)
+            return true;
+        lookup(cellGrid, box, found);
+        // what no cell has covered yet
+        pieces.assign(1, box);
+        for (unsigned int index : found)
+        {
+            const Cell& cell = cells[index];
+            if (!touches(cell.box, box, 0.0f))
+                continue;
+            if (cell.seenFrame == frame && touches(cell.box, box, -PORTAL_WALL_THICKNESS))
+                return true;
+            AABB grown(cell.box.min - glm::vec3(PORTAL_TOUCH_MARGIN), cell.box.max + glm::vec3(PORTAL_TOUCH_MARGIN));
+            split.clear();
+            for (const AABB& piece : pieces)
+                subtract(piece, grown, split);
+            pieces.swap(split);
+        }
+        return !pieces.empty();
+    }
+
+    // cells reached by the last findVisible()
+    unsigned int visibleCells() const { return visibleCount; }
+
+private:
+    struct Cell
+    {
+        AABB box;
+        // frame of the last walk that reached the cell, and the screen area it was seen through then
+        unsigned int seenFrame;
+        ScreenRect seenThrough;
+
+        Cell() : seenFrame(0) {}
+    };
+
+    std::vector<Cell> cells;
+    std::vector<AABB> portals;
+    std::unordered_map<uint64_t, std::vector<unsigned int> > cellGrid, portalGrid;
+    unsigned int frame;
+    unsigned int visibleCount;
+    glm::mat4 viewProjection;
+    // results of grid lookups; the walk has one vector per depth
+    std::vector<unsigned int> roots, found;
+    std::vector<AABB> pieces, split;
+    std::vector<std::vector<unsigned int> > cellPortals, portalCells;
+
+    void visit(unsigned int index, const ScreenRect& through, unsigned int depth)
+    {
+        Cell& cell = cells[index];
+        if (cell.seenFrame == frame)
+        {
+            // seen through this much of the screen already: nothing new behind it
+            if (cell.seenThrough.contains(through))
+                return;
+            cell.seenThrough.min = glm::min(cell.seenThrough.min, through.min);
+            cell.seenThrough.max = glm::max(cell.seenThrough.max, through.max);
+        }
+        else
+        {
+            cell.seenFrame = frame;
+            cell.seenThrough = through;
+            visibleCount++;
+        }
+        if (depth == PORTAL_MAX_DEPTH)
+            return;
+        if (cellPortals.size() <= depth)
+        {
+            cellPortals.resize(PORTAL_MAX_DEPTH);
+            portalCells.resize(PORTAL_MAX_DEPTH);
+        }
+        lookup(portalGrid, cell.box, cellPortals[depth]);
+        for (size_t p = 0; p < cellPortals[depth].size(); p++)
+        {
+            AABB portal = portals[cellPortals[depth][p]];
+            if (!touches(portal, cells[index].box, PORTAL_TOUCH_MARGIN))
+                continue;
+            ScreenRect clipped;
+            if (!project(portal, through, clipped))
+                continue;
+            lookup(cellGrid, portal, portalCells[depth]);
+            for (size_t c = 0; c < portalCells[depth].size(); c++)
+            {
+                unsigned int next = portalCells[depth][c];
+                if (next != index && touches(portal, cells[next].box, PORTAL_TOUCH_MARGIN))
+                    visit(next, clipped, depth + 1);
+            }
+        }
+    }
+
+    // the screen area of a box, clipped to what is seen through; false when nothing is left.
+    // A box reaching past the near plane towards the camera takes all of it.
+    bool project(const AABB& box, const ScreenRect& through, ScreenRect& clipped) const
+    {
+        glm::vec2 lo(FLT_MAX), hi(-FLT_MAX);
+        int pastNear = 0, beyondFar = 0;
+        for (int corner = 0; corner < 8; corner++)
+        {
+            glm::vec3 point((corner & 1) ? box.max.x : box.min.x, (corner & 2) ? box.max.y : box.min.y, (corner & 4) ? box.max.z : box.min.z);
+            glm::vec4 clip = viewProjection * glm::vec4(point, 1.0f);
+            if (clip.z < -clip.w)
+                continue;
+            pastNear++;
+            if (clip.z > clip.w)
+                beyondFar++;
+            glm::vec2 ndc(clip.x / clip.w, clip.y / clip.w);
+            lo = glm::min(lo, ndc);
+            hi = glm::max(hi, ndc);
+        }
+        if (pastNear == 0 || beyondFar == 8)
+            return false;
+        if (pastNear < 8)
+        {
+            clipped = through;
+            return true;
+        }
+        clipped.min = glm::max(lo, through.min);
+        clipped.max = glm::min(hi, through.max);
+        return !clipped.empty();
+    }
+
+    static bool touches(const AABB& a, const AABB& b, float margin)
+    {
+        return a.min.x <= b.max.x + margin && a.max.x >= b.min.x - margin
+            && a.min.y <= b.max.y + margin && a.max.y >= b.min.y - margin
+            && a.min.z <= b.max.z + margin && a.max.z >= b.min.z - margin;
+    }
+
+    // the parts of a box outside another, as up to six boxes appended to result
+    static void subtract(AABB box, const AABB& hole, std::vector<AABB>& result)
+    {
+        if (!touches(box, hole, 0.0f))
+        {
+            result.push_back(box);
+            return;
+        }
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (box.min[axis] < hole.min[axis])
+            {
+                AABB below = box;
+                below.max[axis] = hole.min[axis];
+                result.push_back(below);
+                box.min[axis] = hole.min[axis];
+            }
+            if (box.max[axis] > hole.max[axis])
+            {
+                AABB above = box;
+                above.min[axis] = hole.max[axis];
+                result.push_back(above);
+                box.max[axis] = hole.max[axis];
+            }
+        }
+    }
+
+    static int64_t gridCoordinate(float value)
+    {
+        return (int64_t)std::floor(value / PORTAL_GRID_SIZE);
+    }
+
+    // 21 bits per axis, centered on the origin
+    static uint64_t gridKey(int64_t x, int64_t y, int64_t z)
+    {
+        return ((uint64_t)(x + (1 << 20)) & 0x1FFFFF) << 42 | ((uint64_t)(y + (1 << 20)) & 0x1FFFFF) << 21 | ((uint64_t)(z + (1 << 20)) & 0x1FFFFF);
+    }
+
+    static uint64_t keyCount(const AABB& box)
+    {
+        return (uint64_t)(gridCoordinate(box.max.x) - gridCoordinate(box.min.x) + 1)
+            * (uint64_t)(gridCoordinate(box.max.y) - gridCoordinate(box.min.y) + 1)
+            * (uint64_t)(gridCoordinate(box.max.z) - gridCoordinate(box.min.z) + 1);
+    }
+
+    // calls visit(key) for every grid cell the box overlaps
+    template <typename Visit>
+    static void forEachKey(const AABB& box, Visit visit)
+    {
+        int64_t x0 = gridCoordinate(box.min.x), x1 = gridCoordinate(box.max.x);
+        int64_t y0 = gridCoordinate(box.min.y), y1 = gridCoordinate(box.max.y);
+        int64_t z0 = gridCoordinate(box.min.z), z1 = gridCoordinate(box.max.z);
+        for (int64_t x = x0; x <= x1; x++)
+            for (int64_t y = y0; y <= y1; y++)
+                for (int64_t z = z0; z <= z1; z++)
+                    visit(gridKey(x, y, z));
+    }
+
+    static void insert(std::unordered_map<uint64_t, std::vector<unsigned int> >& grid, const AABB& box, unsigned int index)
+    {
+        if (box.empty())
+            return;
+        forEachKey(box, [&](uint64_t key) { grid[key].push_back(index); });
+    }
+
+    static void erase(std::unordered_map<uint64_t, std::vector<unsigned int> >& grid, const AABB& box, unsigned int index)
+    {
+        if (box.empty())
+            return;
+        forEachKey(box, [&](uint64_t key) {
+            std::vector<unsigned int>& bucket = grid[key];
+            bucket.erase(std::remove(bucket.begin(), bucket.end(), index), bucket.end());
+        });
+    }
+
+    // everything in the grid cells the box overlaps, grown by the touch margin, without repeats
+    static void lookup(const std::unordered_map<uint64_t, std::vector<unsigned int> >& grid, const AABB& box, std::vector<unsigned int>& result)
+    {
+        result.clear();
+        glm::vec3 margin(PORTAL_TOUCH_MARGIN);
+        forEachKey(AABB(box.min - margin, box.max + margin), [&](uint64_t key) {
+            std::unordered_map<uint64_t, std::vector<unsigned int> >::const_iterator it = grid.find(key);
+            if (it != grid.end())
+                result.insert(result.end(), it->second.begin(), it->second.end());
+        });
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+    }
+};
+
+#endif
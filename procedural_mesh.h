@@ -0,0 +1,187 @@
+//
+//  procedural_mesh.h
+//  3D Object Drawing
+//
+//  Round meshes built from a segment count instead of typed-in arrays:
+//  discs, cylinders, cones (and cones cut short, like the lamp shade) and
+//  spheres, in the vertex layout of mesh.h. A mesh keeps how far its flat
+//  facets stray from the true surface, and makeLodChain() builds the same
+//  shape at halving segment counts, finest first, for lod.h to choose from.
+//
+
+#ifndef PROCEDURAL_MESH_H
+#define PROCEDURAL_MESH_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
+
+struct ProceduralMesh
+{
+    // position and color, six floats per vertex
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    // largest distance between the facets and the round surface, in model units
+    float error;
+
+    ProceduralMesh() : error(0.0f) {}
+
+    unsigned int addVertex(const glm::vec3& position, const glm::vec3& color)
+    {
+        vertices.push_back(position.x);
+        vertices.push_back(position.y);
+        vertices.push_back(position.z);
+        vertices.push_back(color.x);
+        vertices.push_back(color.y);
+        vertices.push_back(color.z);
+        return (unsigned int)(vertices.size() / 6 - 1);
+    }
+
+    void addTriangle(unsigned int a, unsigned int b, unsigned int c)
+    {
+        indices.push_back(a);
+        indices.push_back(b);
+        indices.push_back(c);
+    }
+};
+
+const float PROCEDURAL_PI = 3.14159265358979f;
+
+// how far the chords of a circle cut into with that many segments fall inside it
+inline float chordError(float radius, unsigned int segments)
+{
+    return radius * (1.0f - std::cos(PROCEDURAL_PI / segments));
+}
+
+namespace procedural_detail
+{
+    // a ring of segments vertices around the y axis; the first sits on +x
+    inline unsigned int ring(ProceduralMesh& mesh, float radius, float y, unsigned int segments, const glm::vec3& color)
+    {
+        unsigned int first = (unsigned int)(mesh.vertices.size() / 6);
+        for (unsigned int i = 0; i < segments; i++)
+        {
+            float angle = 2.0f * PROCEDURAL_PI * i / segments;
+            mesh.addVertex(glm::vec3(radius * std::cos(angle), y, radius * std::sin(angle)), color);
+        }
+        return first;
+    }
+
+    // a fan from the center to a ring; up decides which side faces out
+    inline void cap(ProceduralMesh& mesh, unsigned int ringStart, float y, unsigned int segments, bool up, const glm::vec3& color)
+    {
+        unsigned int center = mesh.addVertex(glm::vec3(0.0f, y, 0.0f), color);
+        for (unsigned int i = 0; i < segments; i++)
+        {
+            unsigned int a = ringStart + i;
+            unsigned int b = ringStart + (i + 1) % segments;
+            if (up)
+                mesh.addTriangle(center, b, a);
+            else
+                mesh.addTriangle(center, a, b);
+        }
+    }
+}
+
+// a flat circle at height y, facing up or down
+inline ProceduralMesh makeDisc(float radius, float y, unsigned int segments, bool up, const glm::vec3& color)
+{
+    segments = std::max(3u, segments);
+    ProceduralMesh mesh;
+    unsigned int rim = procedural_detail::ring(mesh, radius, y, segments, color);
+    procedural_detail::cap(mesh, rim, y, segments, up, color);
+    mesh.error = chordError(radius, segments);
+    return mesh;
+}
+
+// the side between two circles around the y axis, closed with discs if caps is set. A radius of
+// 0 gives a cone; equal radii a cylinder.
+inline ProceduralMesh makeFrustum(float bottomRadius, float topRadius, float bottomY, float topY, unsigned int segments, bool caps, const glm::vec3& color)
+{
+    segments = std::max(3u, segments);
+    ProceduralMesh mesh;
+    unsigned int bottom = procedural_detail::ring(mesh, bottomRadius, bottomY, segments, color);
+    unsigned int top = procedural_detail::ring(mesh, topRadius, topY, segments, color);
+    for (unsigned int i = 0; i < segments; i++)
+    {
+        unsigned int next = (i + 1) % segments;
+        mesh.addTriangle(bottom + i, top + i, top + next);
+        mesh.addTriangle(top + next, bottom + next, bottom + i);
+    }
+    if (caps)
+    {
+        if (bottomRadius > 0.0f)
+            procedural_detail::cap(mesh, bottom, bottomY, segments, false, color);
+        if (topRadius > 0.0f)
+            procedural_detail::cap(mesh, top, topY, segments, true, color);
+    }
+    mesh.error = chordError(std::max(bottomRadius, topRadius), segments);
+    return mesh;
+}
+
+inline ProceduralMesh makeCylinder(float radius, float bottomY, float topY, unsigned int segments, bool caps, const glm::vec3& color)
+{
+    return makeFrustum(radius, radius, bottomY, topY, segments, caps, color);
+}
+
+// the tip is at topY
+inline ProceduralMesh makeCone(float radius, float bottomY, float topY, unsigned int segments, bool cap, const glm::vec3& color)
+{
+    return makeFrustum(radius, 0.0f, bottomY, topY, segments, cap, color);
+}
+
+// centered on the origin; segments around the equator and half as many rings from pole to pole
+inline ProceduralMesh makeSphere(float radius, unsigned int segments, const glm::vec3& color)
+{
+    segments = std::max(4u, segments);
+    unsigned int rings = segments / 2;
+    ProceduralMesh mesh;
+    unsigned int south = mesh.addVertex(glm::vec3(0.0f, -radius, 0.0f), color);
+    // rings 1..rings-1 between the poles
+    unsigned int first = (unsigned int)(mesh.vertices.size() / 6);
+    for (unsigned int r = 1; r < rings; r++)
+    {
+        float polar = PROCEDURAL_PI * r / rings;
+        procedural_detail::ring(mesh, radius * std::sin(polar), -radius * std::cos(polar), segments, color);
+    }
+    unsigned int north = mesh.addVertex(glm::vec3(0.0f, radius, 0.0f), color);
+    for (unsigned int i = 0; i < segments; i++)
+    {
+        unsigned int next = (i + 1) % segments;
+        mesh.addTriangle(south, first + i, first + next);
+        unsigned int last = first + (rings - 2) * segments;
+        mesh.addTriangle(north, last + next, last + i);
+    }
+    for (unsigned int r = 0; r + 2 < rings; r++)
+    {
+        unsigned int below = first + r * segments;
+        unsigned int above = below + segments;
+        for (unsigned int i = 0; i < segments; i++)
+        {
+            unsigned int next = (i + 1) % segments;
+            mesh.addTriangle(below + i, above + i, above + next);
+            mesh.addTriangle(above + next, below + next, below + i);
+        }
+    }
+    mesh.error = chordError(radius, segments);
+    return mesh;
+}
+
+// make(segments) at finest, finest / 2, ... down to coarsest segments, finest first
+inline std::vector<ProceduralMesh> makeLodChain(const std::function<ProceduralMesh(unsigned int)>& make, unsigned int finest, unsigned int coarsest)
+{
+    std::vector<ProceduralMesh> levels;
+    coarsest = std::max(3u, coarsest);
+    for (unsigned int segments = std::max(finest, coarsest); segments >= coarsest; segments /= 2)
+    {
+        levels.push_back(make(segments));
+        if (segments / 2 < coarsest)
+            break;
+    }
+    return levels;
+}
+
+#endif
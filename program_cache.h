@@ -0,0 +1,171 @@
+//
+//  program_cache.h
+//  3D Object Drawing
+//
+//  Linked programs saved to disk with glGetProgramBinary and loaded back with
+//  glProgramBinary on the next launch, which skips compiling and linking.
+//  A file is named after a hash of the shader sources and the driver's
+//  vendor, renderer and version strings, so editing a shader or updating the
+//  driver simply misses the cache. A binary the driver rejects is compiled
+//  from source again and overwritten.
+//
+
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+
+#include "gl_extensions.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+const uint32_t PROGRAM_CACHE_MAGIC = 0x42505242u; // "BRPB" read as little-endian bytes
+const uint32_t PROGRAM_CACHE_VERSION = 1;
+
+struct ProgramCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    // repeated here so a renamed or truncated file is not taken for another program
+    uint64_t key;
+    uint32_t binaryFormat;
+    uint32_t length;
+};
+
+class ProgramCache
+{
+public:
+    // programs that came from the cache and programs that had to be compiled
+    unsigned int hits, misses;
+
+    explicit ProgramCache(const std::string& directory = "shader_cache") : hits(0), misses(0), directory(directory), enabled(true)
+    {
+    }
+
+    // when off, every program is compiled from source and nothing is written
+    void setEnabled(bool on) { enabled = on; }
+
+    // the context must be current and glExtensions() loaded
+    bool isEnabled() const { return enabled && glExtensions().programBinary; }
+
+    // 64-bit FNV-1a of the sources and the driver identity
+    uint64_t key(const std::string& vertexCode, const std::string& fragmentCode) const
+    {
+        uint64_t hash = 14695981039346656037ull;
+        hashString(hash, vertexCode.c_str());
+        hashString(hash, fragmentCode.c_str());
+        hashString(hash, (const char*)glGetString(GL_VENDOR));
+        hashString(hash, (const char*)glGetString(GL_RENDERER));
+        hashString(hash, (const char*)glGetString(GL_VERSION));
+        return hash;
+    }
+
+    // true if program is now linked from the cached binary
+    bool load(uint64_t key, GLuint program)
+    {
+        std::ifstream file(path(key).c_str(), std::ios::binary);
+        ProgramCacheHeader header;
+        if (!file || !file.read((char*)&header, sizeof(header)) || header.magic != PROGRAM_CACHE_MAGIC
+            || header.version != PROGRAM_CACHE_VERSION || header.key != key || header.length == 0)
+        {
+            misses++;
+            return false;
+        }
+        std::vector<char> binary(header.length);
+        if (!file.read(&binary[0], binary.size()))
+        {
+            misses++;
+            return false;
+        }
+        glExtensions().loadProgramBinary(program, header.binaryFormat, &binary[0], (GLsizei)binary.size());
+        // a driver update with an unchanged version string can still reject the binary
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked)
+        {
+            misses++;
+            return false;
+        }
+        hits++;
+        return true;
+    }
+
+    // call before glLinkProgram when the binary will be stored
+    void prepare(GLuint program) const
+    {
+        glExtensions().programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    // save a successfully linked program
+    void store(uint64_t key, GLuint program)
+    {
+        GLint linked = 0, length = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (!linked || length <= 0)
+            return;
+        std::vector<char> binary(length);
+        ProgramCacheHeader header;
+        header.magic = PROGRAM_CACHE_MAGIC;
+        header.version = PROGRAM_CACHE_VERSION;
+        header.key = key;
+        GLenum binaryFormat = 0;
+        GLsizei written = 0;
+        glExtensions().getProgramBinary(program, length, &written, &binaryFormat, &binary[0]);
+        header.binaryFormat = binaryFormat;
+        header.length = (uint32_t)written;
+
+        createDirectory();
+        std::ofstream file(path(key).c_str(), std::ios::binary | std::ios::trunc);
+        file.write((const char*)&header, sizeof(header));
+        file.write(&binary[0], written);
+        if (!file)
+            std::cout << "ERROR::PROGRAM_CACHE::FILE_NOT_SUCCESSFULLY_WRITTEN: " << path(key) << std::endl;
+    }
+
+private:
+    std::string directory;
+    bool enabled;
+
+    static void hashString(uint64_t& hash, const char* text)
+    {
+        // the terminator is hashed too, so "ab" + "c" and "a" + "bc" differ
+        for (const char* c = text != NULL ? text : ""; ; c++)
+        {
+            hash ^= (unsigned char)*c;
+            hash *= 1099511628211ull;
+            if (*c == '\0')
+                break;
+        }
+    }
+
+    std::string path(uint64_t key) const
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return directory + "/" + name;
+    }
+
+    // an existing directory is fine
+    void createDirectory() const
+    {
+#ifdef _WIN32
+        _mkdir(directory.c_str());
+#else
+        mkdir(directory.c_str(), 0755);
+#endif
+    }
+};
+
+#endif
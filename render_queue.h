@@ -0,0 +1,234 @@
+//
+//  render_queue.h
+//  3D Object Drawing
+//
+//  A frame's draws as packets with a 64-bit sort key. Culling pushes objects
+//  in whatever order it finds them; sort() brings together what shares
+//  state: opaque before translucent, then program, vertex array, mesh and
+//  material, and front to back last so the depth test throws away hidden
+//  fragments before they are shaded. Translucent packets go back to front
+//  instead, as blending needs. Keys are radix sorted a byte at a time,
+//  skipping the bytes every key agrees on. Sorted by group as well, the
+//  packets of a group (a scene section) come together, in key order within
+//  it, so its draws can be bracketed by a timer or a condition. RenderState
+//  remembers what is bound, so drawing the sorted packets skips binds that
+//  change nothing.
+//
+//  Key layout, most significant bits first:
+//      opaque        pass:2 program:6 vertexArray:8 mesh:24 material:8 depth:16
+//      translucent   pass:2 farness:24 program:6 vertexArray:8 mesh:24
+//  Depth is the distance along the view direction as float bits, which
+//  order like the values for positive floats; farness is depth inverted.
+//
+
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+#include "mesh.h"
+#include "vertex_format.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+enum RenderPass
+{
+    RENDER_OPAQUE = 0,
+    RENDER_TRANSLUCENT = 1
+};
+
+struct RenderPacket
+{
+    uint64_t key;
+    const Mesh* mesh;
+    unsigned int object;
+    unsigned int group;
+};
+
+class RenderQueue
+{
+public:
+    RenderQueue() : view(1.0f)
+    {
+    }
+
+    // once per frame, before the packets of the frame are pushed
+    void setView(const glm::mat4& viewMatrix) { view = viewMatrix; }
+
+    // queue one object; the mesh must outlive the queue's next clear()
+    void push(RenderPass pass, unsigned int program, const Mesh& mesh, unsigned int material, const AABB& worldBox, unsigned int object, unsigned int group = 0)
+    {
+        RenderPacket packet;
+        float depth = viewDepth(worldBox);
+        packet.key = pass == RENDER_TRANSLUCENT ? translucentKey(program, mesh, depth) : opaqueKey(program, mesh, material, depth);
+        packet.mesh = &mesh;
+        packet.object = object;
+        packet.group = group;
+        packets.push_back(packet);
+    }
+
+    // the packets in key order, or in group order and key order within a group; valid until
+    // the next push() or clear()
+    const std::vector<RenderPacket>& sort(bool byGroup = false)
+    {
+        radixSort(byGroup ? 12 : 8);
+        return packets;
+    }
+
+    // the packets as the last sort() left them
+    const std::vector<RenderPacket>& sorted() const { return packets; }
+
+    void clear() { packets.clear(); }
+    size_t size() const { return packets.size(); }
+
+    static RenderPass passOf(uint64_t key) { return (RenderPass)(key >> 62); }
+
+    static uint64_t opaqueKey(unsigned int program, const Mesh& mesh, unsigned int material, float depth)
+    {
+        return ((uint64_t)RENDER_OPAQUE << 62) | ((uint64_t)(program & 0x3F) << 56) | (meshBits(mesh) << 24)
+            | ((uint64_t)(material & 0xFF) << 16) | (depthBits(depth) >> 16);
+    }
+
+    static uint64_t translucentKey(unsigned int program, const Mesh& mesh, float depth)
+    {
+        uint64_t farness = ~(uint64_t)(depthBits(depth) >> 8) & 0xFFFFFF;
+        return ((uint64_t)RENDER_TRANSLUCENT << 62) | (farness << 38) | ((uint64_t)(program & 0x3F) << 32) | meshBits(mesh);
+    }
+
+private:
+    glm::mat4 view;
+    std::vector<RenderPacket> packets;
+    // the other half of every radix pass
+    std::vector<RenderPacket> scratch;
+    // a count per value of every key byte, then where that value goes
+    std::vector<size_t> histograms;
+
+    // how far in front of the camera the center of the box is; behind it counts as 0
+    float viewDepth(const AABB& box) const
+    {
+        glm::vec3 center = box.center();
+        float depth = -(view[0][2] * center.x + view[1][2] * center.y + view[2][2] * center.z + view[3][2]);
+        return depth > 0.0f ? depth : 0.0f;
+    }
+
+    static uint32_t depthBits(float depth)
+    {
+        uint32_t bits;
+        memcpy(&bits, &depth, sizeof(bits));
+        return bits;
+    }
+
+    // vertex array, then where the mesh starts in its index buffer; meshes of a pool start on
+    // four-byte boundaries, so the byte offset over four tells them apart
+    static uint64_t meshBits(const Mesh& mesh)
+    {
+        uint64_t start = ((uint64_t)mesh.firstIndex * indexSize(mesh.indexType)) >> 2;
+        return ((uint64_t)(mesh.VAO & 0xFF) << 24) | (start & 0xFFFFFF);
+    }
+
+    // byte of the sort order: the key's eight, least significant first, then the group's four
+    static unsigned int sortByte(const RenderPacket& packet, int byte)
+    {
+        if (byte < 8)
+            return (unsigned int)(packet.key >> (byte * 8)) & 0xFF;
+        return (packet.group >> ((byte - 8) * 8)) & 0xFF;
+    }
+
+    // least significant byte first; every pass is stable, so it keeps the order of the bytes before it
+    void radixSort(int bytes)
+    {
+        size_t count = packets.size();
+        if (count < 2)
+            return;
+        scratch.resize(count);
+        histograms.assign(bytes * 256, 0);
+        for (const RenderPacket& packet : packets)
+        {
+            for (int byte = 0; byte < bytes; byte++)
+                histograms[byte * 256 + sortByte(packet, byte)]++;
+        }
+        for (int byte = 0; byte < bytes; byte++)
+        {
+            size_t* histogram = &histograms[byte * 256];
+            if (histogram[sortByte(packets[0], byte)] == count)
+                continue;
+            size_t offset = 0;
+            for (int digit = 0; digit < 256; digit++)
+            {
+                size_t digitCount = histogram[digit];
+                histogram[digit] = offset;
+                offset += digitCount;
+            }
+            for (const RenderPacket& packet : packets)
+                scratch[histogram[sortByte(packet, byte)]++] = packet;
+            packets.swap(scratch);
+        }
+    }
+};
+
+// the GL state the packets were last drawn with
+class RenderState
+{
+public:
+    RenderState() : currentPass(RENDER_OPAQUE)
+    {
+        reset();
+    }
+
+    // forget the bindings, e.g. at the start of a frame; the pass is always left opaque
+    void reset()
+    {
+        vertexArray = 0xFFFFFFFFu;
+        material = -1;
+    }
+
+    void bindVertexArray(unsigned int VAO)
+    {
+        if (VAO == vertexArray)
+            return;
+        glBindVertexArray(VAO);
+        vertexArray = VAO;
+    }
+
+    // true when the material is not the one set last, so its uniforms have to be set
+    bool changeMaterial(unsigned int index)
+    {
+        if ((int)index == material)
+            return false;
+        material = (int)index;
+        return true;
+    }
+
+    // translucent packets blend over what is drawn and leave the depth buffer alone
+    void setPass(RenderPass pass)
+    {
+        if (pass == currentPass)
+            return;
+        if (pass == RENDER_TRANSLUCENT)
+        {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glDepthMask(GL_FALSE);
+        }
+        else
+        {
+            glDisable(GL_BLEND);
+            glDepthMask(GL_TRUE);
+        }
+        currentPass = pass;
+    }
+
+    RenderPass pass() const { return currentPass; }
+
+private:
+    unsigned int vertexArray;
+    int material;
+    RenderPass currentPass;
+};
+
+#endif
@@ -0,0 +1,974 @@
+//
+//  scene_file.h
+//  3D Object Drawing
+//
+//  Compact binary scene format: meshes, materials, prefabs (reusable groups of
+//  parts such as Bed, Table or Fan) and prefab instances. The whole file is
+//  memory mapped and mesh data is uploaded straight from the mapping. A mesh
+//  may come with coarser levels of detail (lod.h): they follow it in the mesh
+//  table and a LOD record names the chain and the error of every level.
+//  Parts that never move are merged into per-material chunk meshes while
+//  the scene is instantiated (static_merge.h). Parts can also mark the
+//  rooms and the openings between them for portal culling (portals.h).
+//
+//  Layout (little endian, every field 4 bytes):
+//      SceneFileHeader
+//      SceneMeshRecord[meshCount]
+//      SceneMaterialRecord[materialCount]
+//      ScenePrefabRecord[prefabCount]
+//      ScenePartRecord[partCount]          parts of a prefab are contiguous
+//      SceneInstanceRecord[instanceCount]
+//      SceneLodRecord[lodCount]            from version 2 on
+//      float[materialCount]                opacity of every material, from version 3 on
+//      vertex and index data referenced by the mesh records
+//
+
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include <glm/glm.hpp>
+
+#include "geometry_pool.h"
+#include "lod.h"
+#include "material.h"
+#include "mesh.h"
+#include "procedural_mesh.h"
+#include "static_merge.h"
+#include "static_scene.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+const char SCENE_FILE_MAGIC[4] = { 'B', 'R', 'S', 'C' };
+const uint32_t SCENE_FILE_VERSION = 3;
+// version 1 files have no LOD table and end the header before lodCount
+const size_t SCENE_FILE_V1_HEADER_SIZE = 32;
+const uint32_t SCENE_NAME_LENGTH = 32;
+// mesh index of a part that only groups other parts
+const uint32_t SCENE_NO_MESH = 0xFFFFFFFFu;
+// part flag: the part spins around its local y axis (fan blades)
+const uint32_t SCENE_PART_SPIN = 1u;
+// part flag: the part bounds a room; a room is the box around its instance's flagged parts
+const uint32_t SCENE_PART_CELL = 2u;
+// part flag: the part's box is an opening, such as a window, into the rooms it touches
+const uint32_t SCENE_PART_PORTAL = 4u;
+const uint32_t SCENE_MAX_LOD_LEVELS = 6;
+
+struct SceneFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t meshCount;
+    uint32_t materialCount;
+    uint32_t prefabCount;
+    uint32_t partCount;
+    uint32_t instanceCount;
+    uint32_t dataSize;
+    uint32_t lodCount;
+};
+
+// vertices are six floats (position, color); indices are 32-bit; offsets are from the start of the file
+struct SceneMeshRecord
+{
+    uint32_t vertexOffset;
+    uint32_t vertexCount;
+    uint32_t indexOffset;
+    uint32_t indexCount;
+};
+
+struct SceneMaterialRecord
+{
+    char name[SCENE_NAME_LENGTH];
+    float color[3];
+};
+
+struct ScenePrefabRecord
+{
+    char name[SCENE_NAME_LENGTH];
+    uint32_t firstPart;
+    uint32_t partCount;
+};
+
+// translation, rotation in degrees and scale, as taken by transforamtion()
+struct SceneTransformRecord
+{
+    float translation[3];
+    float rotation[3];
+    float scale[3];
+};
+
+struct ScenePartRecord
+{
+    int32_t parent;     // index inside the prefab, -1 for the prefab root
+    uint32_t mesh;      // SCENE_NO_MESH for a group
+    uint32_t material;
+    uint32_t flags;
+    SceneTransformRecord transform;
+};
+
+struct SceneInstanceRecord
+{
+    uint32_t prefab;
+    SceneTransformRecord transform;
+};
+
+// meshes firstMesh..firstMesh+levelCount-1 are one shape, finest first; parts use firstMesh.
+// errors[i] is how far level i strays from the true surface over its bounding radius.
+struct SceneLodRecord
+{
+    uint32_t firstMesh;
+    uint32_t levelCount;
+    float errors[SCENE_MAX_LOD_LEVELS];
+};
+
+static_assert(sizeof(SceneFileHeader) == 36, "scene header must be packed");
+static_assert(sizeof(SceneLodRecord) == 32, "scene LOD record must be packed");
+static_assert(sizeof(ScenePartRecord) == 52, "scene part must be packed");
+static_assert(sizeof(SceneInstanceRecord) == 40, "scene instance must be packed");
+
+inline SceneTransformRecord toRecord(const Transform& transform)
+{
+    SceneTransformRecord record;
+    for (int i = 0; i < 3; i++)
+    {
+        record.translation[i] = transform.translation[i];
+        record.rotation[i] = transform.rotation[i];
+        record.scale[i] = transform.scale[i];
+    }
+    return record;
+}
+
+inline Transform fromRecord(const SceneTransformRecord& record)
+{
+    return Transform(record.translation[0], record.translation[1], record.translation[2],
+        record.rotation[0], record.rotation[1], record.rotation[2],
+        record.scale[0], record.scale[1], record.scale[2]);
+}
+
+// Read-only, memory-mapped file. Unmapped when destroyed.
+class MappedFile
+{
+public:
+    MappedFile() : bytes(NULL), length(0)
+    {
+#ifdef _WIN32
+        file = INVALID_HANDLE_VALUE;
+        mapping = NULL;
+#endif
+    }
+    ~MappedFile() { close(); }
+
+    bool open(const char* path)
+    {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            close();
+            return false;
+        }
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping == NULL)
+        {
+            close();
+            return false;
+        }
+        bytes = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        length = (size_t)fileSize.QuadPart;
+#else
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void* address = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED)
+            return false;
+        bytes = (const unsigned char*)address;
+        length = (size_t)info.st_size;
+#endif
+        return bytes != NULL;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (bytes != NULL)
+            UnmapViewOfFile(bytes);
+        if (mapping != NULL)
+            CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE)
+            CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (bytes != NULL)
+            munmap((void*)bytes, length);
+#endif
+        bytes = NULL;
+        length = 0;
+    }
+
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char* bytes;
+    size_t length;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+};
+
+// Validated view over a serialized scene; the records point into the caller's buffer, nothing is copied.
+class SceneFile
+{
+public:
+    const SceneFileHeader* header;
+    const SceneMeshRecord* meshes;
+    const SceneMaterialRecord* materials;
+    const ScenePrefabRecord* prefabs;
+    const ScenePartRecord* parts;
+    const SceneInstanceRecord* instances;
+    const SceneLodRecord* lods;
+    // read from the header, 0 for version 1 files
+    uint32_t lodCount;
+    // NULL before version 3, whose materials are all opaque
+    const float* opacities;
+
+    SceneFile() : header(NULL), meshes(NULL), materials(NULL), prefabs(NULL), parts(NULL), instances(NULL), lods(NULL), lodCount(0), opacities(NULL), base(NULL), size(0)
+    {
+    }
+
+    bool parse(const unsigned char* data, size_t dataSize)
+    {
+        base = data;
+        size = dataSize;
+        if (data == NULL || size < SCENE_FILE_V1_HEADER_SIZE || ((uintptr_t)data & 3) != 0)
+            return fail("file is too small or misaligned");
+        header = (const SceneFileHeader*)data;
+        if (memcmp(header->magic, SCENE_FILE_MAGIC, 4) != 0)
+            return fail("not a scene file");
+        if (header->version < 1 || header->version > SCENE_FILE_VERSION)
+            return fail("unsupported version");
+        if (header->version >= 2 && size < sizeof(SceneFileHeader))
+            return fail("file is too small");
+
+        size_t offset = header->version >= 2 ? sizeof(SceneFileHeader) : SCENE_FILE_V1_HEADER_SIZE;
+        lodCount = header->version >= 2 ? header->lodCount : 0;
+        meshes = (const SceneMeshRecord*)table(offset, header->meshCount, sizeof(SceneMeshRecord));
+        materials = (const SceneMaterialRecord*)table(offset, header->materialCount, sizeof(SceneMaterialRecord));
+        prefabs = (const ScenePrefabRecord*)table(offset, header->prefabCount, sizeof(ScenePrefabRecord));
+        parts = (const ScenePartRecord*)table(offset, header->partCount, sizeof(ScenePartRecord));
+        instances = (const SceneInstanceRecord*)table(offset, header->instanceCount, sizeof(SceneInstanceRecord));
+        lods = (const SceneLodRecord*)table(offset, lodCount, sizeof(SceneLodRecord));
+        opacities = header->version >= 3 ? (const float*)table(offset, header->materialCount, sizeof(float)) : NULL;
+        if (offset > size)
+            return fail("record tables run past the end of the file");
+
+        for (uint32_t i = 0; i < header->meshCount; i++)
+        {
+            const SceneMeshRecord& mesh = meshes[i];
+            if (!inside(mesh.vertexOffset, (uint64_t)mesh.vertexCount * 6 * sizeof(float)) || !inside(mesh.indexOffset, (uint64_t)mesh.indexCount * sizeof(uint32_t)))
+                return fail("mesh data runs past the end of the file");
+            const uint32_t* indices = (const uint32_t*)(base + mesh.indexOffset);
+            for (uint32_t index = 0; index < mesh.indexCount; index++)
+            {
+                if (indices[index] >= mesh.vertexCount)
+                    return fail("mesh index out of range");
+            }
+        }
+        for (uint32_t i = 0; i < header->prefabCount; i++)
+        {
+            const ScenePrefabRecord& prefab = prefabs[i];
+            if ((uint64_t)prefab.firstPart + prefab.partCount > header->partCount)
+                return fail("prefab parts out of range");
+            for (uint32_t part = 0; part < prefab.partCount; part++)
+            {
+                const ScenePartRecord& record = parts[prefab.firstPart + part];
+                if (record.parent >= (int32_t)part || record.parent < -1)
+                    return fail("part parent must come before the part");
+                if (record.mesh != SCENE_NO_MESH && (record.mesh >= header->meshCount || record.material >= header->materialCount))
+                    return fail("part mesh or material out of range");
+            }
+        }
+        for (uint32_t i = 0; i < header->instanceCount; i++)
+        {
+            if (instances[i].prefab >= header->prefabCount)
+                return fail("instance prefab out of range");
+        }
+        for (uint32_t i = 0; i < lodCount; i++)
+        {
+            const SceneLodRecord& lod = lods[i];
+            if (lod.levelCount == 0 || lod.levelCount > SCENE_MAX_LOD_LEVELS || (uint64_t)lod.firstMesh + lod.levelCount > header->meshCount)
+                return fail("LOD levels out of range");
+        }
+        for (uint32_t i = 0; opacities != NULL && i < header->materialCount; i++)
+        {
+            if (!(opacities[i] >= 0.0f && opacities[i] <= 1.0f))
+                return fail("material opacity out of range");
+        }
+        return true;
+    }
+
+    const float* vertices(const SceneMeshRecord& mesh) const { return (const float*)(base + mesh.vertexOffset); }
+    const uint32_t* indices(const SceneMeshRecord& mesh) const { return (const uint32_t*)(base + mesh.indexOffset); }
+    float opacity(uint32_t material) const { return opacities != NULL ? opacities[material] : 1.0f; }
+
+private:
+    const unsigned char* base;
+    size_t size;
+
+    const void* table(size_t& offset, uint32_t count, size_t recordSize)
+    {
+        const void* start = base + (offset <= size ? offset : size);
+        offset += (size_t)count * recordSize;
+        return start;
+    }
+
+    bool inside(uint32_t offset, uint64_t bytes) const
+    {
+        return (offset & 3) == 0 && (uint64_t)offset + bytes <= size;
+    }
+
+    bool fail(const char* reason)
+    {
+        std::cout << "ERROR::SCENE::INVALID_FILE: " << reason << std::endl;
+        header = NULL;
+        return false;
+    }
+};
+
+// Builds a scene in memory and serializes it to the file format.
+class SceneBuilder
+{
+public:
+    unsigned int addMesh(const float* vertices, size_t verticesSize, const unsigned int* indices, size_t indicesSize)
+    {
+        MeshData mesh;
+        mesh.vertices.assign(vertices, vertices + verticesSize / sizeof(float));
+        mesh.indices.assign(indices, indices + indicesSize / sizeof(unsigned int));
+        meshes.push_back(mesh);
+        return (unsigned int)meshes.size() - 1;
+    }
+
+    unsigned int addMesh(const ProceduralMesh& mesh)
+    {
+        return addMesh(mesh.vertices.data(), mesh.vertices.size() * sizeof(float), mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+    }
+
+    // the levels of one shape, finest first (see makeLodChain); returns the mesh parts should use
+    unsigned int addLodChain(const std::vector<ProceduralMesh>& levels)
+    {
+        SceneLodRecord lod;
+        memset(&lod, 0, sizeof(lod));
+        lod.firstMesh = (uint32_t)meshes.size();
+        lod.levelCount = (uint32_t)std::min<size_t>(levels.size(), SCENE_MAX_LOD_LEVELS);
+        for (uint32_t i = 0; i < lod.levelCount; i++)
+        {
+            addMesh(levels[i]);
+            AABB bounds = meshBounds(levels[i].vertices.data(), levels[i].vertices.size() * sizeof(float));
+            float radius = glm::length(bounds.extent());
+            lod.errors[i] = radius > 0.0f ? levels[i].error / radius : 0.0f;
+        }
+        lods.push_back(lod);
+        return lod.firstMesh;
+    }
+
+    // an opacity below 1 makes the material translucent
+    unsigned int addMaterial(const std::string& name, const glm::vec3& color, float opacity = 1.0f)
+    {
+        SceneMaterialRecord material;
+        memset(&material, 0, sizeof(material));
+        copyName(material.name, name);
+        material.color[0] = color.x;
+        material.color[1] = color.y;
+        material.color[2] = color.z;
+        materials.push_back(material);
+        opacities.push_back(opacity);
+        return (unsigned int)materials.size() - 1;
+    }
+
+    // parts added afterwards belong to this prefab until the next beginPrefab()
+    unsigned int beginPrefab(const std::string& name)
+    {
+        ScenePrefabRecord prefab;
+        memset(&prefab, 0, sizeof(prefab));
+        copyName(prefab.name, name);
+        prefab.firstPart = (uint32_t)parts.size();
+        prefab.partCount = 0;
+        prefabs.push_back(prefab);
+        return (unsigned int)prefabs.size() - 1;
+    }
+
+    // returns the part's index inside the current prefab, usable as parent of later parts
+    int addPart(unsigned int mesh, unsigned int material, const Transform& transform, int parent = -1, uint32_t flags = 0)
+    {
+        ScenePartRecord part;
+        part.parent = parent;
+        part.mesh = mesh;
+        part.material = material;
+        part.flags = flags;
+        part.transform = toRecord(transform);
+        parts.push_back(part);
+        return (int)(prefabs.back().partCount++);
+    }
+
+    int addGroup(const Transform& transform, int parent = -1, uint32_t flags = 0)
+    {
+        return addPart(SCENE_NO_MESH, 0, transform, parent, flags);
+    }
+
+    void addInstance(unsigned int prefab, const Transform& transform)
+    {
+        SceneInstanceRecord instance;
+        instance.prefab = prefab;
+        instance.transform = toRecord(transform);
+        instances.push_back(instance);
+    }
+
+    int findPrefab(const std::string& name) const
+    {
+        for (size_t i = 0; i < prefabs.size(); i++)
+        {
+            if (name == prefabs[i].name)
+                return (int)i;
+        }
+        return -1;
+    }
+
+    // objects an instance of the prefab adds to the scene: its parts that have a mesh
+    unsigned int drawnParts(unsigned int prefab) const
+    {
+        unsigned int count = 0;
+        const ScenePrefabRecord& record = prefabs[prefab];
+        for (uint32_t i = 0; i < record.partCount; i++)
+        {
+            if (parts[record.firstPart + i].mesh != SCENE_NO_MESH)
+                count++;
+        }
+        return count;
+    }
+
+    std::vector<unsigned char> serialize() const
+    {
+        size_t tables = sizeof(SceneFileHeader) + meshes.size() * sizeof(SceneMeshRecord) + materials.size() * sizeof(SceneMaterialRecord)
+            + prefabs.size() * sizeof(ScenePrefabRecord) + parts.size() * sizeof(ScenePartRecord) + instances.size() * sizeof(SceneInstanceRecord)
+            + lods.size() * sizeof(SceneLodRecord) + opacities.size() * sizeof(float);
+        size_t total = tables;
+        for (const MeshData& mesh : meshes)
+            total += mesh.vertices.size() * sizeof(float) + mesh.indices.size() * sizeof(uint32_t);
+
+        std::vector<unsigned char> bytes(total);
+        SceneFileHeader header;
+        memcpy(header.magic, SCENE_FILE_MAGIC, 4);
+        header.version = SCENE_FILE_VERSION;
+        header.meshCount = (uint32_t)meshes.size();
+        header.materialCount = (uint32_t)materials.size();
+        header.prefabCount = (uint32_t)prefabs.size();
+        header.partCount = (uint32_t)parts.size();
+        header.instanceCount = (uint32_t)instances.size();
+        header.dataSize = (uint32_t)(total - tables);
+        header.lodCount = (uint32_t)lods.size();
+
+        size_t offset = 0;
+        write(bytes, offset, &header, sizeof(header));
+        size_t dataOffset = tables;
+        for (const MeshData& mesh : meshes)
+        {
+            SceneMeshRecord record;
+            record.vertexOffset = (uint32_t)dataOffset;
+            record.vertexCount = (uint32_t)(mesh.vertices.size() / 6);
+            dataOffset += mesh.vertices.size() * sizeof(float);
+            record.indexOffset = (uint32_t)dataOffset;
+            record.indexCount = (uint32_t)mesh.indices.size();
+            dataOffset += mesh.indices.size() * sizeof(uint32_t);
+            write(bytes, offset, &record, sizeof(record));
+        }
+        writeTable(bytes, offset, materials);
+        writeTable(bytes, offset, prefabs);
+        writeTable(bytes, offset, parts);
+        writeTable(bytes, offset, instances);
+        writeTable(bytes, offset, lods);
+        writeTable(bytes, offset, opacities);
+        for (const MeshData& mesh : meshes)
+        {
+            write(bytes, offset, mesh.vertices.data(), mesh.vertices.size() * sizeof(float));
+            write(bytes, offset, mesh.indices.data(), mesh.indices.size() * sizeof(uint32_t));
+        }
+        return bytes;
+    }
+
+    bool save(const char* path) const
+    {
+        std::vector<unsigned char> bytes = serialize();
+        std::ofstream file(path, std::ios::binary);
+        file.write((const char*)bytes.data(), bytes.size());
+        if (!file)
+        {
+            std::cout << "ERROR::SCENE::FILE_NOT_SUCCESSFULLY_WRITTEN: " << path << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+private:
+    struct MeshData
+    {
+        std::vector<float> vertices;
+        std::vector<uint32_t> indices;
+    };
+
+    std::vector<MeshData> meshes;
+    std::vector<SceneMaterialRecord> materials;
+    std::vector<ScenePrefabRecord> prefabs;
+    std::vector<ScenePartRecord> parts;
+    std::vector<SceneInstanceRecord> instances;
+    std::vector<SceneLodRecord> lods;
+    std::vector<float> opacities;
+
+    // names are zero padded and always zero terminated
+    static void copyName(char* destination, const std::string& name)
+    {
+        size_t length = name.size() < SCENE_NAME_LENGTH - 1 ? name.size() : SCENE_NAME_LENGTH - 1;
+        memcpy(destination, name.c_str(), length);
+    }
+
+    static void write(std::vector<unsigned char>& bytes, size_t& offset, const void* data, size_t size)
+    {
+        if (size == 0)
+            return;
+        memcpy(&bytes[offset], data, size);
+        offset += size;
+    }
+
+    template <typename T>
+    static void writeTable(std::vector<unsigned char>& bytes, size_t& offset, const std::vector<T>& table)
+    {
+        if (!table.empty())
+            write(bytes, offset, table.data(), table.size() * sizeof(T));
+    }
+};
+
+// what instantiateScene created besides the scene objects
+struct LoadedScene
+{
+    // every mesh of the file lives in the pool, so the whole scene shares one VAO
+    GeometryPool pool;
+    // the layout the pool stores vertices in; set before loading
+    VertexFormat vertexFormat;
+    // bake parts that never move into one mesh per material and chunk; set before loading
+    bool mergeStatic;
+    float mergeChunkSize;
+    std::vector<Mesh> meshes;
+    // nodes flagged SCENE_PART_SPIN, e.g. the blade group of every fan
+    std::vector<unsigned int> spinners;
+    // the file's LOD chains; objects point into it, so it is sized once before any object exists
+    std::vector<LodChain> lods;
+
+    LoadedScene() : vertexFormat(VERTEX_COMPACT), mergeStatic(true), mergeChunkSize(MERGE_CHUNK_SIZE)
+    {
+    }
+
+    void release()
+    {
+        pool.release();
+        meshes.clear();
+        spinners.clear();
+        lods.clear();
+    }
+};
+
+// names are zero-padded, not necessarily zero-terminated
+inline std::string recordName(const char* name)
+{
+    size_t length = 0;
+    while (length < SCENE_NAME_LENGTH && name[length] != '\0')
+        length++;
+    return std::string(name, length);
+}
+
+// a scene file read and checked off the render thread; the GL side is SceneStreamer's job
+struct SceneSource
+{
+    MappedFile mapped;
+    // the built-in scene, serialized in memory
+    std::vector<unsigned char> serialized;
+    SceneFile file;
+    // bounds of every mesh; computing them also pulls mapped vertex pages into memory here instead of during the upload
+    std::vector<AABB> meshBounds;
+
+    // map and validate a scene file
+    bool open(const char* path)
+    {
+        return mapped.open(path) && file.parse(mapped.data(), mapped.size()) && decode();
+    }
+
+    // take over an in-memory scene and validate it
+    bool open(std::vector<unsigned char>& bytes)
+    {
+        serialized.swap(bytes);
+        return file.parse(serialized.data(), serialized.size()) && decode();
+    }
+
+    // once the meshes are in GL buffers the file is no longer needed
+    void close()
+    {
+        mapped.close();
+        std::vector<unsigned char>().swap(serialized);
+        meshBounds.clear();
+    }
+
+private:
+    bool decode()
+    {
+        meshBounds.resize(file.header->meshCount);
+        for (uint32_t i = 0; i < file.header->meshCount; i++)
+            meshBounds[i] = ::meshBounds(file.vertices(file.meshes[i]), file.meshes[i].vertexCount * MESH_VERTEX_SIZE);
+        return true;
+    }
+};
+
+// Instantiates a scene file a little at a time: every step() uploads up to a byte budget of
+// mesh data into the geometry pool, then adds the instances whose meshes are all resident.
+// An instance appears with all its parts in one step, so no frame shows half a bed; its merged
+// parts appear with the rest of their chunk, once the chunk's last instance is in.
+class SceneStreamer
+{
+public:
+    SceneStreamer() : file(NULL), bounds(NULL), scene(NULL), loaded(NULL), firstMaterial(0), nextMesh(0), nextInstance(0)
+    {
+    }
+
+    // add the materials, plan the merged chunks and allocate the pool for every mesh; bounds may be NULL
+    void begin(const SceneFile& sceneFile, const std::vector<AABB>* meshBounds, StaticScene& target, MaterialTable& materials, LoadedScene& result)
+    {
+        file = &sceneFile;
+        scene = &target;
+        loaded = &result;
+        nextMesh = nextInstance = 0;
+
+        const SceneFileHeader& header = *file->header;
+        bounds = meshBounds;
+        if (bounds == NULL || bounds->size() != header.meshCount)
+        {
+            ownBounds.resize(header.meshCount);
+            for (uint32_t i = 0; i < header.meshCount; i++)
+                ownBounds[i] = ::meshBounds(file->vertices(file->meshes[i]), file->meshes[i].vertexCount * MESH_VERTEX_SIZE);
+            bounds = &ownBounds;
+        }
+        firstMaterial = (unsigned int)materials.size();
+        for (uint32_t i = 0; i < header.materialCount; i++)
+        {
+            const SceneMaterialRecord& material = file->materials[i];
+            materials.add(recordName(material.name), glm::vec3(material.color[0], material.color[1], material.color[2]), file->opacity(i));
+        }
+        loaded->meshes.clear();
+
+        // every level of a chain belongs to it; objects hold pointers, so the chains never move after this
+        lodOfMesh.assign(header.meshCount, -1);
+        loaded->lods.clear();
+        loaded->lods.resize(file->lodCount);
+        lodBoxes.assign(file->lodCount, AABB());
+        for (uint32_t i = 0; i < file->lodCount; i++)
+        {
+            const SceneLodRecord& record = file->lods[i];
+            LodChain& chain = loaded->lods[i];
+            chain.levels.resize(record.levelCount);
+            chain.errors.assign(record.errors, record.errors + record.levelCount);
+            for (uint32_t level = 0; level < record.levelCount; level++)
+            {
+                uint32_t mesh = record.firstMesh + level;
+                lodOfMesh[mesh] = (int)i;
+                // the levels share one quantization box, so one model matrix fits them all
+                lodBoxes[i].grow((*bounds)[mesh]);
+            }
+        }
+
+        planMerge();
+        size_t vertexCount = 0, indexStorage = 0;
+        merger.storage(loaded->vertexFormat, vertexCount, indexStorage);
+        for (uint32_t i = 0; i < header.meshCount; i++)
+        {
+            vertexCount += file->meshes[i].vertexCount;
+            indexStorage += GeometryPool::indexStorage(loaded->vertexFormat, file->meshes[i].vertexCount, file->meshes[i].indexCount);
+        }
+        loaded->pool.create(vertexCount, indexStorage, loaded->vertexFormat);
+    }
+
+    // upload at most byteBudget bytes of meshes (at least one mesh; 0 means everything) and
+    // add the instances that became complete; returns true when the whole scene is in
+    bool step(size_t byteBudget = 0)
+    {
+        const SceneFileHeader& header = *file->header;
+        size_t uploaded = 0;
+        while (nextMesh < header.meshCount && (byteBudget == 0 || uploaded == 0 || uploaded < byteBudget))
+        {
+            const SceneMeshRecord& mesh = file->meshes[nextMesh];
+            size_t verticesSize = mesh.vertexCount * MESH_VERTEX_SIZE;
+            size_t indicesSize = mesh.indexCount * sizeof(uint32_t);
+            int lod = lodOfMesh[nextMesh];
+            loaded->meshes.push_back(loaded->pool.add(file->vertices(mesh), verticesSize, file->indices(mesh), indicesSize,
+                &(*bounds)[nextMesh], lod >= 0 ? &lodBoxes[lod] : NULL));
+            if (lod >= 0)
+                loaded->lods[lod].levels[nextMesh - file->lods[lod].firstMesh] = loaded->meshes.back();
+            uploaded += verticesSize + indicesSize;
+            nextMesh++;
+        }
+        while (nextInstance < header.instanceCount && resident(file->instances[nextInstance]))
+            addInstance(nextInstance++);
+        return done();
+    }
+
+    bool done() const { return file != NULL && nextInstance == file->header->instanceCount; }
+
+private:
+    const SceneFile* file;
+    const std::vector<AABB>* bounds;
+    // mesh bounds, when the caller has none
+    std::vector<AABB> ownBounds;
+    StaticScene* scene;
+    LoadedScene* loaded;
+    unsigned int firstMaterial;
+    uint32_t nextMesh;
+    uint32_t nextInstance;
+    std::vector<unsigned int> partNodes;
+    // LOD chain of every mesh, -1 for meshes without one
+    std::vector<int> lodOfMesh;
+    // box around every level of a chain
+    std::vector<AABB> lodBoxes;
+    StaticMerger merger;
+    // per part of the file: baked into a chunk mesh instead of becoming an object
+    std::vector<char> mergedPart;
+    // per prefab: parts that are merged, and drawn parts that stay objects
+    std::vector<unsigned int> prefabMerged, prefabKept;
+    // chunk every instance merges into, or MERGE_NO_CHUNK
+    std::vector<unsigned int> instanceChunk;
+    // per prefab: some part is flagged SCENE_PART_CELL or SCENE_PART_PORTAL
+    std::vector<char> prefabMarksRooms;
+    std::vector<glm::mat4> partWorlds;
+
+    // the chain a part draws from: only a part on the finest level gets the coarser ones
+    int lodOfPart(uint32_t mesh) const
+    {
+        int lod = lodOfMesh[mesh];
+        return lod >= 0 && file->lods[lod].firstMesh == mesh ? lod : -1;
+    }
+
+    // meshes are uploaded in file order, so an instance is ready once its highest mesh is
+    bool resident(const SceneInstanceRecord& instance) const
+    {
+        const ScenePrefabRecord& prefab = file->prefabs[instance.prefab];
+        for (uint32_t p = 0; p < prefab.partCount; p++)
+        {
+            uint32_t mesh = file->parts[prefab.firstPart + p].mesh;
+            if (mesh == SCENE_NO_MESH)
+                continue;
+            int lod = lodOfPart(mesh);
+            if (lod >= 0)
+                mesh = file->lods[lod].firstMesh + file->lods[lod].levelCount - 1;
+            if (mesh >= nextMesh)
+                return false;
+        }
+        return true;
+    }
+
+    // which parts can be merged and how much every chunk will get, so the pool has room for it
+    void planMerge()
+    {
+        const SceneFileHeader& header = *file->header;
+        // a part is static unless it or a group above it spins; a part with children keeps its node for them
+        mergedPart.assign(header.partCount, 0);
+        prefabMerged.assign(header.prefabCount, 0);
+        prefabKept.assign(header.prefabCount, 0);
+        prefabMarksRooms.assign(header.prefabCount, 0);
+        std::vector<char> spins, parentOfOthers;
+        for (uint32_t i = 0; i < header.prefabCount; i++)
+        {
+            const ScenePrefabRecord& prefab = file->prefabs[i];
+            spins.assign(prefab.partCount, 0);
+            parentOfOthers.assign(prefab.partCount, 0);
+            for (uint32_t p = 0; p < prefab.partCount; p++)
+            {
+                const ScenePartRecord& part = file->parts[prefab.firstPart + p];
+                spins[p] = (part.flags & SCENE_PART_SPIN) != 0 || (part.parent >= 0 && spins[part.parent]);
+                if (part.parent >= 0)
+                    parentOfOthers[part.parent] = 1;
+                if (part.mesh != SCENE_NO_MESH && (part.flags & (SCENE_PART_CELL | SCENE_PART_PORTAL)))
+                    prefabMarksRooms[i] = 1;
+            }
+            for (uint32_t p = 0; p < prefab.partCount; p++)
+            {
+                const ScenePartRecord& part = file->parts[prefab.firstPart + p];
+                if (part.mesh == SCENE_NO_MESH)
+                    continue;
+                // objects with levels of detail pick their mesh every frame
+                if (loaded->mergeStatic && !spins[p] && !parentOfOthers[p] && lodOfPart(part.mesh) < 0)
+                {
+                    mergedPart[prefab.firstPart + p] = 1;
+                    prefabMerged[i]++;
+                }
+                else
+                    prefabKept[i]++;
+            }
+        }
+
+        merger.clear();
+        merger.setChunkSize(loaded->mergeChunkSize);
+        instanceChunk.assign(header.instanceCount, MERGE_NO_CHUNK);
+        for (uint32_t i = 0; i < header.instanceCount; i++)
+        {
+            const SceneInstanceRecord& instance = file->instances[i];
+            if (prefabMerged[instance.prefab] == 0)
+                continue;
+            const ScenePrefabRecord& prefab = file->prefabs[instance.prefab];
+            placeParts(instance, partWorlds);
+            AABB box;
+            for (uint32_t p = 0; p < prefab.partCount; p++)
+            {
+                if (mergedPart[prefab.firstPart + p])
+                    box.grow((*bounds)[file->parts[prefab.firstPart + p].mesh].transformed(partWorlds[p]));
+            }
+            unsigned int chunk = merger.chunkOf(box);
+            merger.expectInstance(chunk);
+            for (uint32_t p = 0; p < prefab.partCount; p++)
+            {
+                const ScenePartRecord& part = file->parts[prefab.firstPart + p];
+                if (mergedPart[prefab.firstPart + p])
+                    merger.expectPart(chunk, part.material, file->meshes[part.mesh].vertexCount, file->meshes[part.mesh].indexCount);
+            }
+            instanceChunk[i] = chunk;
+        }
+    }
+
+    // world matrix of every part of an instance, computed as the transform hierarchy does
+    void placeParts(const SceneInstanceRecord& instance, std::vector<glm::mat4>& worlds) const
+    {
+        const ScenePrefabRecord& prefab = file->prefabs[instance.prefab];
+        glm::mat4 root = fromRecord(instance.transform).matrix();
+        worlds.resize(prefab.partCount);
+        for (uint32_t p = 0; p < prefab.partCount; p++)
+        {
+            const ScenePartRecord& part = file->parts[prefab.firstPart + p];
+            worlds[p] = (part.parent < 0 ? root : worlds[part.parent]) * fromRecord(part.transform).matrix();
+        }
+    }
+
+    // upload the merged meshes of a complete chunk; each is an object of its own, already in world space
+    void flushChunk(unsigned int index)
+    {
+        scene->beginSection("Static");
+        for (const MergeBucket& bucket : merger.chunk(index).buckets)
+        {
+            if (bucket.indices.empty())
+                continue;
+            Mesh mesh = loaded->pool.add(bucket.vertices.data(), bucket.vertices.size() * sizeof(float), bucket.indices.data(), bucket.indices.size() * sizeof(unsigned int), &bucket.bounds);
+            scene->add(mesh, firstMaterial + bucket.material, glm::mat4(1.0f));
+        }
+        merger.release(index);
+    }
+
+    // the room and the openings an instance marks, placed where the instance is
+    void addRooms(const SceneInstanceRecord& instance)
+    {
+        const ScenePrefabRecord& prefab = file->prefabs[instance.prefab];
+        AABB cell;
+        for (uint32_t p = 0; p < prefab.partCount; p++)
+        {
+            const ScenePartRecord& part = file->parts[prefab.firstPart + p];
+            if (part.mesh == SCENE_NO_MESH)
+                continue;
+            if (part.flags & SCENE_PART_CELL)
+                cell.grow((*bounds)[part.mesh].transformed(partWorlds[p]));
+            if (part.flags & SCENE_PART_PORTAL)
+                scene->portals.addPortal((*bounds)[part.mesh].transformed(partWorlds[p]));
+        }
+        if (!cell.empty())
+            scene->portals.addCell(cell);
+    }
+
+    void addInstance(uint32_t index)
+    {
+        const SceneInstanceRecord& instance = file->instances[index];
+        const ScenePrefabRecord& prefab = file->prefabs[instance.prefab];
+        unsigned int chunk = instanceChunk[index];
+        // every instance is its own section (bed, fan, ...) so it can be profiled on its own,
+        // unless all of it went into the chunk meshes
+        if (prefabKept[instance.prefab] > 0 || prefabMerged[instance.prefab] == 0)
+            scene->beginSection(recordName(prefab.name));
+        if (chunk != MERGE_NO_CHUNK || prefabMarksRooms[instance.prefab])
+            placeParts(instance, partWorlds);
+        if (prefabMarksRooms[instance.prefab])
+            addRooms(instance);
+        unsigned int root = scene->addGroup(fromRecord(instance.transform));
+        partNodes.resize(prefab.partCount);
+        for (uint32_t p = 0; p < prefab.partCount; p++)
+        {
+            const ScenePartRecord& part = file->parts[prefab.firstPart + p];
+            int parent = part.parent < 0 ? (int)root : (int)partNodes[part.parent];
+            if (mergedPart[prefab.firstPart + p])
+            {
+                // a leaf, so nothing needs its node
+                const SceneMeshRecord& mesh = file->meshes[part.mesh];
+                merger.add(chunk, part.material, partWorlds[p], file->vertices(mesh), mesh.vertexCount, file->indices(mesh), mesh.indexCount);
+                partNodes[p] = 0;
+            }
+            else if (part.mesh == SCENE_NO_MESH)
+                partNodes[p] = scene->addGroup(fromRecord(part.transform), parent);
+            else
+            {
+                SceneObject& object = scene->objects[scene->add(loaded->meshes[part.mesh], firstMaterial + part.material, fromRecord(part.transform), parent)];
+                int lod = lodOfPart(part.mesh);
+                if (lod >= 0)
+                    object.lod = &loaded->lods[lod];
+                partNodes[p] = object.node;
+            }
+            if (part.flags & SCENE_PART_SPIN)
+                loaded->spinners.push_back(partNodes[p]);
+        }
+        if (chunk != MERGE_NO_CHUNK && merger.instanceDone(chunk))
+            flushChunk(chunk);
+    }
+};
+
+// upload the meshes (straight from the file's memory) into one geometry pool and create a node per instance and part
+inline void instantiateScene(const SceneFile& file, StaticScene& scene, MaterialTable& materials, LoadedScene& loaded)
+{
+    SceneStreamer streamer;
+    streamer.begin(file, NULL, scene, materials, loaded);
+    streamer.step();
+}
+
+#endif
@@ -11,71 +11,148 @@
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
+#include "program_cache.h"
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
+#include <vector>
+
+// pre-resolved uniform location; the type parameter keeps a handle from being set with the wrong value type
+template <typename T>
+struct Uniform
+{
+    GLint location;
+    Uniform() : location(-1) {}
+    explicit Uniform(GLint location) : location(location) {}
+};
+
+// fixed binding points shared by every program; a Shader connects them right after linking,
+// so per-frame data bound there once reaches all programs
+// std140 block "Camera": view, projection, viewProjection (camera_uniforms.h)
+const GLuint CAMERA_BLOCK_BINDING = 0;
+// samplerBuffer "objects": per-object model matrix and color (object_buffer.h)
+const GLint OBJECT_BUFFER_UNIT = 0;
 
 class Shader
 {
 public:
     unsigned int ID;
-    // constructor generates the shader on the fly
+    // the program was loaded from the program cache instead of being compiled
+    bool fromCache;
+    // constructor generates the shader on the fly, or takes the binary from cache when it has one
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath)
+    Shader(const char* vertexPath, const char* fragmentPath, ProgramCache* cache = NULL) : ID(0), fromCache(false), vertex(0), fragment(0), pending(false), cache(NULL), key(0)
     {
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
         std::string fragmentCode;
-        std::ifstream vShaderFile;
-        std::ifstream fShaderFile;
+        readFile(vertexPath, vertexCode);
+        readFile(fragmentPath, fragmentCode);
+        compile(vertexCode, fragmentCode, cache);
+        finish();
+    }
+    // an empty shader, built later with compile() once the sources have been read
+    // ------------------------------------------------------------------------
+    Shader() : ID(0), fromCache(false), vertex(0), fragment(0), pending(false), cache(NULL), key(0)
+    {
+    }
+    // read a source file; safe to call from any thread
+    // ------------------------------------------------------------------------
+    static bool readFile(const char* path, std::string& code)
+    {
+        std::ifstream shaderFile;
         // ensure ifstream objects can throw exceptions:
-        vShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-        fShaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+        shaderFile.exceptions(std::ifstream::failbit | std::ifstream::badbit);
         try
         {
-            // open files
-            vShaderFile.open(vertexPath);
-            fShaderFile.open(fragmentPath);
-            std::stringstream vShaderStream, fShaderStream;
-            // read file's buffer contents into streams
-            vShaderStream << vShaderFile.rdbuf();
-            fShaderStream << fShaderFile.rdbuf();
-            // close file handlers
-            vShaderFile.close();
-            fShaderFile.close();
+            // open file
+            shaderFile.open(path);
+            std::stringstream shaderStream;
+            // read file's buffer contents into stream
+            shaderStream << shaderFile.rdbuf();
+            // close file handler
+            shaderFile.close();
             // convert stream into string
-            vertexCode = vShaderStream.str();
-            fragmentCode = fShaderStream.str();
+            code = shaderStream.str();
+            return true;
         }
         catch (std::ifstream::failure& e)
         {
-            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << path << " " << e.what() << std::endl;
+            return false;
+        }
+    }
+    // start building the program without waiting for the driver; finish() completes it
+    // ------------------------------------------------------------------------
+    void compile(const std::string& vertexCode, const std::string& fragmentCode, ProgramCache* programCache = NULL)
+    {
+        ID = glCreateProgram();
+        pending = true;
+        cache = programCache != NULL && programCache->isEnabled() ? programCache : NULL;
+        if (cache != NULL)
+        {
+            key = cache->key(vertexCode, fragmentCode);
+            fromCache = cache->load(key, ID);
+            if (fromCache)
+                return;
         }
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
         // 2. compile shaders
-        unsigned int vertex, fragment;
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex, 1, &vShaderCode, NULL);
         glCompileShader(vertex);
-        checkCompileErrors(vertex, "VERTEX");
         // fragment Shader
         fragment = glCreateShader(GL_FRAGMENT_SHADER);
         glShaderSource(fragment, 1, &fShaderCode, NULL);
         glCompileShader(fragment);
-        checkCompileErrors(fragment, "FRAGMENT");
         // shader Program
-        ID = glCreateProgram();
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
+        if (cache != NULL)
+            cache->prepare(ID);
         glLinkProgram(ID);
-        checkCompileErrors(ID, "PROGRAM");
-        // delete the shaders as they're linked into our program now and no longer necessary
-        glDeleteShader(vertex);
-        glDeleteShader(fragment);
-
+    }
+    // true once finish() would not wait; without KHR_parallel_shader_compile the driver cannot tell, so always true
+    // ------------------------------------------------------------------------
+    bool isReady() const
+    {
+        if (!pending || fromCache || !glExtensions().parallelShaderCompile)
+            return true;
+        GLint done = GL_FALSE;
+        glGetProgramiv(ID, GL_COMPLETION_STATUS_KHR, &done);
+        return done == GL_TRUE;
+    }
+    // compiled, linked and reflected; the program can be used
+    // ------------------------------------------------------------------------
+    bool isLinked() const { return ID != 0 && !pending; }
+    // report errors, store the binary and reflect the uniforms; blocks until the driver is done
+    // ------------------------------------------------------------------------
+    void finish()
+    {
+        if (!pending)
+            return;
+        pending = false;
+        if (!fromCache)
+        {
+            checkCompileErrors(vertex, "VERTEX");
+            checkCompileErrors(fragment, "FRAGMENT");
+            checkCompileErrors(ID, "PROGRAM");
+            // delete the shaders as they're linked into our program now and no longer necessary
+            glDeleteShader(vertex);
+            glDeleteShader(fragment);
+            vertex = fragment = 0;
+            if (cache != NULL)
+                cache->store(key, ID);
+        }
+        // 3. cache the location of every active uniform
+        reflectUniforms();
+        // 4. attach the shared blocks and buffers the program uses
+        bindSharedResources();
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -83,66 +160,172 @@ public:
     {
         glUseProgram(ID);
     }
+    // location of a uniform from the table built at link time, -1 if it is not active
+    // ------------------------------------------------------------------------
+    GLint getUniformLocation(const std::string& name) const
+    {
+        std::unordered_map<std::string, GLint>::const_iterator it = uniformLocations.find(name);
+        if (it != uniformLocations.end())
+            return it->second;
+        // names the reflection does not list (e.g. "lights[3]") are asked once and remembered
+        GLint location = glGetUniformLocation(ID, name.c_str());
+        uniformLocations[name] = location;
+        return location;
+    }
+    // resolve a handle once, outside the render loop
+    // ------------------------------------------------------------------------
+    template <typename T>
+    Uniform<T> uniform(const std::string& name) const
+    {
+        return Uniform<T>(getUniformLocation(name));
+    }
+    // handle uniform functions: no string building, no lookups
+    // ------------------------------------------------------------------------
+    void set(Uniform<bool> uniform, bool value) const
+    {
+        glUniform1i(uniform.location, (int)value);
+    }
+    void set(Uniform<int> uniform, int value) const
+    {
+        glUniform1i(uniform.location, value);
+    }
+    void set(Uniform<float> uniform, float value) const
+    {
+        glUniform1f(uniform.location, value);
+    }
+    void set(Uniform<glm::vec2> uniform, const glm::vec2& value) const
+    {
+        glUniform2fv(uniform.location, 1, &value[0]);
+    }
+    void set(Uniform<glm::vec3> uniform, const glm::vec3& value) const
+    {
+        glUniform3fv(uniform.location, 1, &value[0]);
+    }
+    void set(Uniform<glm::vec4> uniform, const glm::vec4& value) const
+    {
+        glUniform4fv(uniform.location, 1, &value[0]);
+    }
+    void set(Uniform<glm::mat2> uniform, const glm::mat2& mat) const
+    {
+        glUniformMatrix2fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void set(Uniform<glm::mat3> uniform, const glm::mat3& mat) const
+    {
+        glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
+    void set(Uniform<glm::mat4> uniform, const glm::mat4& mat) const
+    {
+        glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string& name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(getUniformLocation(name), (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string& name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(getUniformLocation(name), value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string& name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(getUniformLocation(name), value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string& name, const glm::vec2& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform2fv(getUniformLocation(name), 1, &value[0]);
     }
     void setVec2(const std::string& name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(getUniformLocation(name), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string& name, const glm::vec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(getUniformLocation(name), 1, &value[0]);
     }
     void setVec3(const std::string& name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(getUniformLocation(name), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string& name, const glm::vec4& value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform4fv(getUniformLocation(name), 1, &value[0]);
     }
     void setVec4(const std::string& name, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(getUniformLocation(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string& name, const glm::mat2& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string& name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string& name, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    mutable std::unordered_map<std::string, GLint> uniformLocations;
+    // state of a build between compile() and finish()
+    unsigned int vertex, fragment;
+    bool pending;
+    ProgramCache* cache;
+    uint64_t key;
+
+    // query every active uniform once after linking (glGetActiveUniform) and remember its location
+    // ------------------------------------------------------------------------
+    void reflectUniforms()
+    {
+        uniformLocations.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        if (count <= 0 || maxLength <= 0)
+            return;
+        std::vector<GLchar> buffer(maxLength);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type = 0;
+            glGetActiveUniform(ID, (GLuint)i, maxLength, &length, &size, &type, &buffer[0]);
+            std::string name(&buffer[0], length);
+            GLint location = glGetUniformLocation(ID, name.c_str());
+            if (location < 0)
+                continue;   // uniform block members have no location
+            uniformLocations[name] = location;
+            // arrays are reported as "name[0]"; make the plain name resolve too
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+                uniformLocations[name.substr(0, name.size() - 3)] = location;
+        }
+    }
+
+    // ------------------------------------------------------------------------
+    void bindSharedResources()
+    {
+        GLuint camera = glGetUniformBlockIndex(ID, "Camera");
+        if (camera != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, camera, CAMERA_BLOCK_BINDING);
+        GLint objects = getUniformLocation("objects");
+        if (objects >= 0)
+        {
+            glUseProgram(ID);
+            glUniform1i(objects, OBJECT_BUFFER_UNIT);
+        }
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
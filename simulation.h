@@ -0,0 +1,86 @@
+//
+//  simulation.h
+//  3D Object Drawing
+//
+//  Fixed-rate update loop. Animation and camera movement advance in ticks of
+//  constant length, however fast frames are drawn, and each frame shows the
+//  state part of the way between the last two ticks. The simulation gives the
+//  same results uncapped, vsynced or under load, and the benchmark, feeding
+//  it a constant frame time, is deterministic.
+//
+
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <glm/glm.hpp>
+
+class FixedTimestep
+{
+public:
+    // a frame that would need more ticks than this drops the rest of its time, so one
+    // long stall slows the simulation down instead of making every later frame catch up
+    static const int MAX_TICKS_PER_FRAME = 8;
+
+    explicit FixedTimestep(double ticksPerSecond = 60.0) : seconds(1.0 / ticksPerSecond), accumulator(0.0), count(0)
+    {
+    }
+
+    void setRate(double ticksPerSecond)
+    {
+        seconds = 1.0 / ticksPerSecond;
+        accumulator = 0.0;
+    }
+
+    // add the time a frame took; returns how many ticks to simulate before drawing it
+    int advance(double frameSeconds)
+    {
+        accumulator += frameSeconds;
+        int ticks = (int)(accumulator / seconds);
+        if (ticks > MAX_TICKS_PER_FRAME)
+        {
+            ticks = MAX_TICKS_PER_FRAME;
+            accumulator = ticks * seconds;
+        }
+        accumulator -= ticks * seconds;
+        count += ticks;
+        return ticks;
+    }
+
+    // length of one tick in seconds
+    float step() const { return (float)seconds; }
+
+    // how far the frame is past the last tick, as a fraction of a tick (0..1)
+    float alpha() const { return (float)(accumulator / seconds); }
+
+    // ticks simulated so far
+    unsigned long long ticks() const { return count; }
+
+private:
+    double seconds;
+    double accumulator;
+    unsigned long long count;
+};
+
+// everything a tick changes that a frame shows
+struct SimulationState
+{
+    glm::vec3 cameraPosition;
+    float cameraYaw, cameraPitch, cameraRoll;
+    float fanAngle;
+};
+
+// the state alpha of the way from previous to current. live is the state now; whatever
+// changed since the last tick outside the simulation (mouse look) shows up without delay.
+inline SimulationState interpolate(const SimulationState& previous, const SimulationState& current, const SimulationState& live, float alpha)
+{
+    float behind = 1.0f - alpha;
+    SimulationState shown;
+    shown.cameraPosition = live.cameraPosition - (current.cameraPosition - previous.cameraPosition) * behind;
+    shown.cameraYaw = live.cameraYaw - (current.cameraYaw - previous.cameraYaw) * behind;
+    shown.cameraPitch = live.cameraPitch - (current.cameraPitch - previous.cameraPitch) * behind;
+    shown.cameraRoll = live.cameraRoll - (current.cameraRoll - previous.cameraRoll) * behind;
+    shown.fanAngle = live.fanAngle - (current.fanAngle - previous.fanAngle) * behind;
+    return shown;
+}
+
+#endif
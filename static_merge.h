@@ -0,0 +1,187 @@
+//
+//  static_merge.h
+//  3D Object Drawing
+//
+//  Furniture that never moves, baked into a few big meshes when the scene
+//  loads. The parts are transformed to world space and appended to one
+//  mesh per material and chunk, where chunks are the cells of a grid over
+//  the scene: a whole room of cubes turns into one object per color, and on
+//  a big building culling still drops the chunks out of view. Each instance
+//  lands in the chunk under the center of its box, so a bed is never split.
+//  The loader says up front how much every chunk will get; a chunk is ready
+//  to upload as soon as its last instance has been added.
+//
+
+#ifndef STATIC_MERGE_H
+#define STATIC_MERGE_H
+
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+#include "geometry_pool.h"
+#include "mesh.h"
+
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// the static parts of one chunk that share a material, in world space
+struct MergeBucket
+{
+    unsigned int material;
+    // what the loader announced, for reserving and for allocating the pool
+    size_t expectedVertices, expectedIndices;
+    // six floats per vertex, as meshes are given
+    std::vector<float> vertices;
+    std::vector<unsigned int> indices;
+    AABB bounds;
+};
+
+struct MergeChunk
+{
+    // instances that have yet to add their parts
+    size_t pending;
+    std::vector<MergeBucket> buckets;
+};
+
+// a room of the bedroom
+const float MERGE_CHUNK_SIZE = 10.0f;
+// chunk of an instance that merges nothing
+const unsigned int MERGE_NO_CHUNK = 0xFFFFFFFFu;
+
+class StaticMerger
+{
+public:
+    StaticMerger() : chunkSize(MERGE_CHUNK_SIZE)
+    {
+    }
+
+    // edge of a chunk in world units; 0 or less puts the whole scene in one chunk
+    void setChunkSize(float size) { chunkSize = size; }
+    float getChunkSize() const { return chunkSize; }
+
+    void clear()
+    {
+        chunks.clear();
+        chunkIndices.clear();
+    }
+
+    // the chunk under the center of a box, created the first time it is asked for
+    unsigned int chunkOf(const AABB& box)
+    {
+        uint64_t key = 0;
+        if (chunkSize > 0.0f && !box.empty())
+        {
+            glm::vec3 center = box.center();
+            // 21 bits per axis, centered on the origin
+            for (int axis = 0; axis < 3; axis++)
+            {
+                int64_t cell = (int64_t)std::floor(center[axis] / chunkSize);
+                key = (key << 21) | ((uint64_t)(cell + (1 << 20)) & 0x1FFFFF);
+            }
+        }
+        std::unordered_map<uint64_t, unsigned int>::iterator it = chunkIndices.find(key);
+        if (it != chunkIndices.end())
+            return it->second;
+        MergeChunk chunk;
+        chunk.pending = 0;
+        chunks.push_back(chunk);
+        unsigned int index = (unsigned int)chunks.size() - 1;
+        chunkIndices[key] = index;
+        return index;
+    }
+
+    // before loading: one more instance will add parts to the chunk
+    void expectInstance(unsigned int chunk)
+    {
+        chunks[chunk].pending++;
+    }
+
+    // before loading: one of those parts, a mesh of that size and material
+    void expectPart(unsigned int chunk, unsigned int material, size_t vertices, size_t indices)
+    {
+        MergeBucket& target = bucket(chunk, material);
+        target.expectedVertices += vertices;
+        target.expectedIndices += indices;
+    }
+
+    // vertices and index buffer bytes every announced bucket takes in a pool of that format
+    void storage(VertexFormat format, size_t& vertices, size_t& indexStorage) const
+    {
+        vertices = indexStorage = 0;
+        for (const MergeChunk& chunk : chunks)
+        {
+            for (const MergeBucket& bucket : chunk.buckets)
+            {
+                vertices += bucket.expectedVertices;
+                indexStorage += GeometryPool::indexStorage(format, bucket.expectedVertices, bucket.expectedIndices);
+            }
+        }
+    }
+
+    // transform a part's mesh to world space and append it to its bucket
+    void add(unsigned int chunk, unsigned int material, const glm::mat4& world, const float* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount)
+    {
+        MergeBucket& target = bucket(chunk, material);
+        if (target.vertices.empty())
+        {
+            target.vertices.reserve(target.expectedVertices * 6);
+            target.indices.reserve(target.expectedIndices);
+        }
+        unsigned int base = (unsigned int)(target.vertices.size() / 6);
+        for (size_t i = 0; i < vertexCount; i++)
+        {
+            const float* source = vertices + i * 6;
+            glm::vec3 position = glm::vec3(world * glm::vec4(source[0], source[1], source[2], 1.0f));
+            target.vertices.push_back(position.x);
+            target.vertices.push_back(position.y);
+            target.vertices.push_back(position.z);
+            target.vertices.push_back(source[3]);
+            target.vertices.push_back(source[4]);
+            target.vertices.push_back(source[5]);
+            target.bounds.grow(position);
+        }
+        for (size_t i = 0; i < indexCount; i++)
+            target.indices.push_back(base + indices[i]);
+    }
+
+    // an instance of the chunk has added all its parts; true when it was the last one
+    bool instanceDone(unsigned int chunk)
+    {
+        return --chunks[chunk].pending == 0;
+    }
+
+    MergeChunk& chunk(unsigned int index) { return chunks[index]; }
+
+    // free a chunk's geometry once it is uploaded
+    void release(unsigned int index)
+    {
+        std::vector<MergeBucket>().swap(chunks[index].buckets);
+    }
+
+    size_t chunkCount() const { return chunks.size(); }
+
+private:
+    float chunkSize;
+    std::vector<MergeChunk> chunks;
+    std::unordered_map<uint64_t, unsigned int> chunkIndices;
+
+    // a chunk holds a handful of materials; a linear search is enough
+    MergeBucket& bucket(unsigned int chunk, unsigned int material)
+    {
+        std::vector<MergeBucket>& buckets = chunks[chunk].buckets;
+        for (MergeBucket& bucket : buckets)
+        {
+            if (bucket.material == material)
+                return bucket;
+        }
+        MergeBucket bucket;
+        bucket.material = material;
+        bucket.expectedVertices = bucket.expectedIndices = 0;
+        buckets.push_back(bucket);
+        return buckets.back();
+    }
+};
+
+#endif
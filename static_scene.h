@@ -0,0 +1,290 @@
+//
+//  static_scene.h
+//  3D Object Drawing
+//
+//  Table of the objects in the room. Every object is a node of a transform
+//  hierarchy: static furniture gets its world matrix once when it is added,
+//  animated assemblies only recompute the nodes below what actually moved.
+//  World-space boxes of the objects are kept in a BVH for frustum culling;
+//  objects that move refit it instead of rebuilding it. Given a JobSystem,
+//  update() and cull() spread their work over its threads. The rooms and
+//  the openings between them are kept for portal culling.
+//
+
+#ifndef STATIC_SCENE_H
+#define STATIC_SCENE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "bounds.h"
+#include "bvh.h"
+#include "job_system.h"
+#include "mesh.h"
+#include "portals.h"
+#include "transform_hierarchy.h"
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <vector>
+
+inline glm::mat4 transforamtion(float tx, float ty, float tz, float rx, float ry, float rz, float sx, float sy, float sz) {
+    glm::mat4 identityMatrix = glm::mat4(1.0f); // make sure to initialize matrix to identity matrix first
+    glm::mat4 translateMatrix, rotateXMatrix, rotateYMatrix, rotateZMatrix, scaleMatrix, model;
+    translateMatrix = glm::translate(identityMatrix, glm::vec3(tx, ty, tz));
+    rotateXMatrix = glm::rotate(identityMatrix, glm::radians(rx), glm::vec3(1.0f, 0.0f, 0.0f));
+    rotateYMatrix = glm::rotate(identityMatrix, glm::radians(ry), glm::vec3(0.0f, 1.0f, 0.0f));
+    rotateZMatrix = glm::rotate(identityMatrix, glm::radians(rz), glm::vec3(0.0f, 0.0f, 1.0f));
+    scaleMatrix = glm::scale(identityMatrix, glm::vec3(sx, sy, sz));
+    model = translateMatrix * rotateXMatrix * rotateYMatrix * rotateZMatrix * scaleMatrix;
+    return model;
+}
+
+// the arguments of transforamtion(): translation, rotation in degrees around x, y, z and scale
+struct Transform
+{
+    glm::vec3 translation;
+    glm::vec3 rotation;
+    glm::vec3 scale;
+
+    Transform(float tx = 0, float ty = 0, float tz = 0, float rx = 0, float ry = 0, float rz = 0, float sx = 1, float sy = 1, float sz = 1)
+        : translation(tx, ty, tz), rotation(rx, ry, rz), scale(sx, sy, sz)
+    {
+    }
+
+    glm::mat4 matrix() const
+    {
+        return transforamtion(translation.x, translation.y, translation.z, rotation.x, rotation.y, rotation.z, scale.x, scale.y, scale.z);
+    }
+
+    // the same placement with the rotations as one quaternion
+    Pose pose() const
+    {
+        glm::quat rx = glm::angleAxis(glm::radians(rotation.x), glm::vec3(1.0f, 0.0f, 0.0f));
+        glm::quat ry = glm::angleAxis(glm::radians(rotation.y), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::quat rz = glm::angleAxis(glm::radians(rotation.z), glm::vec3(0.0f, 0.0f, 1.0f));
+        return Pose(translation, rx * ry * rz, scale);
+    }
+};
+
+struct LodChain;
+
+struct SceneObject
+{
+    Mesh mesh;
+    // coarser versions of mesh to draw from far away, or NULL
+    const LodChain* lod;
+    unsigned int material;
+    // node of the object in the transform hierarchy
+    unsigned int node;
+};
+
+// consecutive objects that belong together, e.g. one piece of furniture
+struct SceneSection
+{
+    std::string name;
+    unsigned int firstObject;
+    unsigned int objectCount;
+};
+
+class StaticScene
+{
+public:
+    // below about this many objects per job, splitting the work costs more than it saves
+    static const size_t PARALLEL_GRAIN = 256;
+
+    std::vector<SceneObject> objects;
+    std::vector<SceneSection> sections;
+    // world matrices live here, contiguous and cached until a node changes
+    TransformHierarchy transforms;
+    // world-space box of every object
+    std::vector<AABB> bounds;
+    // rooms as cells, windows and doors as portals
+    PortalVisibility portals;
+
+    StaticScene() : bvhObjects(0)
+    {
+    }
+
+    // objects added from now on belong to a new section with that name
+    void beginSection(const std::string& name)
+    {
+        SceneSection section;
+        section.name = name;
+        section.firstObject = (unsigned int)objects.size();
+        section.objectCount = 0;
+        sections.push_back(section);
+    }
+
+    // node without a mesh that groups an assembly (bed, chair, fan); children are placed relative to it
+    unsigned int addGroup(const glm::mat4& local, int parent = TransformHierarchy::NO_PARENT)
+    {
+        return transforms.addNode(parent, local);
+    }
+    unsigned int addGroup(const Transform& transform, int parent = TransformHierarchy::NO_PARENT)
+    {
+        return transforms.addNode(parent, transform.matrix(), transform.pose());
+    }
+
+    // returns the index of the new object; its world matrix is computed right away
+    unsigned int add(const Mesh& mesh, unsigned int material, const glm::mat4& local, int parent = TransformHierarchy::NO_PARENT)
+    {
+        return addObject(mesh, material, transforms.addNode(parent, local));
+    }
+    unsigned int add(const Mesh& mesh, unsigned int material, const Transform& transform, int parent = TransformHierarchy::NO_PARENT)
+    {
+        return addObject(mesh, material, transforms.addNode(parent, transform.matrix(), transform.pose()));
+    }
+
+    // move a node; it and its descendants are recomputed at the next update()
+    void setLocal(unsigned int node, const glm::mat4& local)
+    {
+        transforms.setLocal(node, local);
+    }
+    void setLocal(unsigned int node, const Pose& local)
+    {
+        transforms.setLocal(node, glm::translate(glm::mat4(1.0f), local.translation) * glm::mat4_cast(local.rotation) * glm::scale(glm::mat4(1.0f), local.scale), local);
+    }
+
+    // the world placement of an object as translation, rotation and scale, or NULL when it has none
+    const Pose* worldPose(unsigned int object) const
+    {
+        return transforms.worldPose(objects[object].node);
+    }
+
+    // recompute only the nodes that changed and refit the BVH above the objects that moved;
+    // returns how many world matrices were rebuilt
+    unsigned int update(JobSystem* jobs = NULL)
+    {
+        if (bvhObjects != objects.size())
+        {
+            bvh.build(bounds);
+            bvhObjects = objects.size();
+        }
+        moved.clear();
+        unsigned int recomputed = transforms.update(jobs);
+        if (recomputed == 0)
+            return 0;
+        for (unsigned int node : transforms.lastUpdated())
+        {
+            int object = node < objectOfNode.size() ? objectOfNode[node] : -1;
+            if (object >= 0)
+                moved.push_back(object);
+        }
+        std::function<void(size_t, size_t)> transformBounds = [this](size_t first, size_t end) {
+            for (size_t i = first; i < end; i++)
+            {
+                unsigned int object = moved[i];
+                bounds[object] = objects[object].mesh.bounds.transformed(transforms.world(objects[object].node));
+            }
+        };
+        if (jobs != NULL)
+            jobs->parallelFor(moved.size(), jobs->grainFor(moved.size(), PARALLEL_GRAIN), transformBounds);
+        else
+            transformBounds(0, moved.size());
+        bvh.refit(bounds, moved);
+        return recomputed;
+    }
+
+    // objects whose box touches the frustum, in object order so sections stay contiguous;
+    // valid until the next call. Call update() first.
+    const std::vector<unsigned int>& cull(const Frustum& frustum, JobSystem* jobs = NULL)
+    {
+        visible.clear();
+        if (jobs == NULL || jobs->threadCount() == 1 || objects.size() < PARALLEL_GRAIN * 4)
+        {
+            bvh.cull(frustum, bounds, visible);
+            std::sort(visible.begin(), visible.end());
+            return visible;
+        }
+        // the top of the tree is tested here; every subtree below it is culled and sorted as its own job
+        bvh.cullTop(frustum, bounds, jobs->threadCount() * 4, visible, cullRoots);
+        if (pieceVisible.size() < cullRoots.size() + 1)
+        {
+            pieceVisible.resize(cullRoots.size() + 1);
+            pieceStacks.resize(cullRoots.size() + 1);
+        }
+        pieceVisible[cullRoots.size()].swap(visible);
+        jobs->parallelFor(cullRoots.size() + 1, 1, [this, &frustum](size_t first, size_t end) {
+            for (size_t piece = first; piece < end; piece++)
+            {
+                // the last piece holds what the top of the tree already settled
+                if (piece < cullRoots.size())
+                {
+                    pieceVisible[piece].clear();
+                    bvh.cull(frustum, bounds, cullRoots[piece], pieceVisible[piece], pieceStacks[piece]);
+                }
+                std::sort(pieceVisible[piece].begin(), pieceVisible[piece].end());
+            }
+        });
+        // join the sorted pieces, then merge neighbouring runs pairwise, the pairs of a round in parallel
+        runs.clear();
+        runs.push_back(0);
+        visible.clear();
+        for (size_t piece = 0; piece <= cullRoots.size(); piece++)
+        {
+            if (pieceVisible[piece].empty())
+                continue;
+            visible.insert(visible.end(), pieceVisible[piece].begin(), pieceVisible[piece].end());
+            runs.push_back(visible.size());
+        }
+        while (runs.size() > 2)
+        {
+            size_t pairs = (runs.size() - 1) / 2;
+            jobs->parallelFor(pairs, 1, [this](size_t first, size_t end) {
+                for (size_t pair = first; pair < end; pair++)
+                    std::inplace_merge(visible.begin() + runs[pair * 2], visible.begin() + runs[pair * 2 + 1], visible.begin() + runs[pair * 2 + 2]);
+            });
+            size_t kept = 0;
+            for (size_t i = 0; i < runs.size(); i += 2)
+                runs[kept++] = runs[i];
+            if ((runs.size() - 1) % 2 == 1)
+                runs[kept++] = runs.back();
+            runs.resize(kept);
+        }
+        return visible;
+    }
+
+    // objects whose world matrix changed in the last update()
+    const std::vector<unsigned int>& movedObjects() const { return moved; }
+
+    const glm::mat4& model(unsigned int object) const
+    {
+        return transforms.world(objects[object].node);
+    }
+
+    size_t size() const { return objects.size(); }
+
+private:
+    unsigned int addObject(const Mesh& mesh, unsigned int material, unsigned int node)
+    {
+        SceneObject object;
+        object.mesh = mesh;
+        object.lod = NULL;
+        object.material = material;
+        object.node = node;
+        objects.push_back(object);
+        objectOfNode.resize(transforms.size(), -1);
+        objectOfNode[object.node] = (int)objects.size() - 1;
+        bounds.push_back(mesh.bounds.transformed(transforms.world(object.node)));
+        if (!sections.empty())
+            sections.back().objectCount++;
+        return (unsigned int)objects.size() - 1;
+    }
+
+    // object of each transform node, -1 for groups
+    std::vector<int> objectOfNode;
+    BVH bvh;
+    size_t bvhObjects;
+    std::vector<unsigned int> moved;
+    std::vector<unsigned int> visible;
+    // parallel culling: subtrees below the top of the tree, what each one found, sorted runs
+    std::vector<int> cullRoots;
+    std::vector<std::vector<unsigned int> > pieceVisible;
+    std::vector<std::vector<int> > pieceStacks;
+    std::vector<size_t> runs;
+};
+
+#endif
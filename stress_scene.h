@@ -0,0 +1,184 @@
+//
+//  stress_scene.h
+//  3D Object Drawing
+//
+//  A building made of copies of the bedroom, for measuring how submission,
+//  culling and memory scale. Rooms sit side by side in a grid of rooms
+//  along x, rooms along z and storeys; the open side of a room is closed
+//  by its neighbour's wall. Free-standing furniture can be pushed and
+//  turned a little in every room, and only some of the fans may spin. The
+//  building depends on the seed alone: each room draws its own random
+//  numbers from the seed and its grid position, so a room looks the same
+//  in a building of any size.
+//
+
+#ifndef STRESS_SCENE_H
+#define STRESS_SCENE_H
+
+#include "bedroom.h"
+#include "fan.h"
+#include "scene_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+struct StressSceneOptions
+{
+    unsigned int roomsX, roomsZ, storeys;
+    uint32_t seed;
+    // free-standing furniture moves up to this far along x and z, and turns up to
+    // STRESS_TURN_PER_UNIT degrees per unit of it
+    float jitter;
+    // share of the rooms whose fan spins, 0..1
+    float spinningFans;
+    // when not 0, as many rooms as it takes to reach this many objects, in a square
+    // grid on every storey; roomsX and roomsZ are ignored
+    size_t targetObjects;
+
+    StressSceneOptions() : roomsX(4), roomsZ(4), storeys(1), seed(1), jitter(0.0f), spinningFans(1.0f), targetObjects(0)
+    {
+    }
+};
+
+// "NxM" or "NxMxK": rooms along x, rooms along z and storeys; false if it is neither
+inline bool parseStressSize(const char* text, StressSceneOptions& options)
+{
+    unsigned long values[3] = { 0, 0, 1 };
+    int count = 0;
+    const char* cursor = text;
+    for (;;)
+    {
+        char* end = NULL;
+        unsigned long value = strtoul(cursor, &end, 10);
+        if (end == cursor || value == 0 || count == 3)
+            return false;
+        values[count++] = value;
+        if (*end == '\0')
+            break;
+        if (*end != 'x' && *end != 'X')
+            return false;
+        cursor = end + 1;
+    }
+    if (count < 2)
+        return false;
+    options.roomsX = (unsigned int)values[0];
+    options.roomsZ = (unsigned int)values[1];
+    options.storeys = (unsigned int)values[2];
+    return true;
+}
+
+// the distance from one room to the next: the room is 10 x 5 x 10 and its ceiling 0.05 thick
+const float STRESS_ROOM_PITCH = 10.0f;
+const float STRESS_STOREY_PITCH = 5.05f;
+const float STRESS_TURN_PER_UNIT = 30.0f;
+
+// splitmix64: small, fast and the same on every compiler, unlike the std distributions
+class StressRandom
+{
+public:
+    explicit StressRandom(uint64_t seed) : state(seed)
+    {
+    }
+
+    uint64_t next()
+    {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        return z ^ (z >> 31);
+    }
+
+    // uniform in [0, 1)
+    float unit()
+    {
+        return (float)(next() >> 40) / (float)(1ull << 24);
+    }
+
+    // uniform in [-range, range)
+    float symmetric(float range)
+    {
+        return (unit() * 2.0f - 1.0f) * range;
+    }
+
+private:
+    uint64_t state;
+};
+
+struct StressSceneStats
+{
+    size_t rooms;
+    size_t objects;
+    size_t spinningFans;
+};
+
+// the bedroom's prefabs once, then one bedroom per room of the building
+inline StressSceneStats buildStressScene(SceneBuilder& builder, const StressSceneOptions& options)
+{
+    BedroomLayout layout = buildBedroomPrefabs(builder);
+    // the same fan without a spinner, for rooms whose fan stands still
+    Fan stillFan;
+    unsigned int stillFanPrefab = stillFan.build(builder, layout.cubeMesh, layout.fanHolderMaterial, layout.fanRodMaterial, layout.fanBladeMaterial, false);
+
+    size_t objectsPerRoom = 0;
+    for (const BedroomLayout::Piece& piece : layout.pieces)
+        objectsPerRoom += builder.drawnParts(piece.prefab);
+
+    unsigned int roomsX = std::max(1u, options.roomsX);
+    unsigned int roomsZ = std::max(1u, options.roomsZ);
+    unsigned int storeys = std::max(1u, options.storeys);
+    size_t rooms = (size_t)roomsX * roomsZ * storeys;
+    if (options.targetObjects > 0)
+    {
+        rooms = std::max<size_t>(1, (options.targetObjects + objectsPerRoom - 1) / objectsPerRoom);
+        size_t perStorey = (rooms + storeys - 1) / storeys;
+        roomsX = std::max(1u, (unsigned int)std::ceil(std::sqrt((double)perStorey)));
+        roomsZ = (unsigned int)((perStorey + roomsX - 1) / roomsX);
+    }
+
+    StressSceneStats stats;
+    stats.rooms = 0;
+    stats.objects = 0;
+    stats.spinningFans = 0;
+    // storey by storey and row by row, so the instances of neighbouring rooms are close in the file
+    for (unsigned int y = 0; y < storeys; y++)
+    {
+        for (unsigned int z = 0; z < roomsZ; z++)
+        {
+            for (unsigned int x = 0; x < roomsX && stats.rooms < rooms; x++)
+            {
+                uint64_t room = ((uint64_t)y << 42) ^ ((uint64_t)z << 21) ^ x;
+                StressRandom random(((uint64_t)options.seed << 32) ^ (room * 0x9E3779B97F4A7C15ull));
+                glm::vec3 offset(x * STRESS_ROOM_PITCH, y * STRESS_STOREY_PITCH, z * STRESS_ROOM_PITCH);
+                for (size_t i = 0; i < layout.pieces.size(); i++)
+                {
+                    const BedroomLayout::Piece& piece = layout.pieces[i];
+                    Transform placement = piece.placement;
+                    placement.translation += offset;
+                    if (piece.movable && options.jitter > 0.0f)
+                    {
+                        placement.translation.x += random.symmetric(options.jitter);
+                        placement.translation.z += random.symmetric(options.jitter);
+                        placement.rotation.y += random.symmetric(options.jitter * STRESS_TURN_PER_UNIT);
+                    }
+                    unsigned int prefab = piece.prefab;
+                    if (i == layout.fan)
+                    {
+                        if (random.unit() < options.spinningFans)
+                            stats.spinningFans++;
+                        else
+                            prefab = stillFanPrefab;
+                    }
+                    builder.addInstance(prefab, placement);
+                }
+                stats.rooms++;
+                stats.objects += objectsPerRoom;
+            }
+        }
+    }
+    return stats;
+}
+
+#endif
@@ -0,0 +1,404 @@
+//
+//  transform_batch.h
+//  3D Object Drawing
+//
+//  World matrices for many objects at once. Translations, rotations and
+//  scales are kept as separate float arrays (one array per component), so
+//  four or eight objects load into one SSE or AVX register per component.
+//  Each matrix is written out in closed form, T * R * S, with no identity
+//  matrices and no matrix products. Rotations are Euler angles in degrees
+//  (the order transforamtion() uses, Rx * Ry * Rz) or unit quaternions.
+//  Matrices go to any float array with a fixed stride, e.g. straight into the
+//  object buffer's texels. Without SSE the scalar loop does the same work.
+//
+
+#ifndef TRANSFORM_BATCH_H
+#define TRANSFORM_BATCH_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "static_scene.h"
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define TRANSFORM_BATCH_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+// MSVC accepts AVX intrinsics in any function; the CPU is asked at run time
+#define TRANSFORM_BATCH_INLINE __forceinline
+#define TRANSFORM_BATCH_AVX
+#define TRANSFORM_BATCH_FLATTEN
+#else
+// GCC and clang only compile AVX inside functions marked for it. The lane operations
+// are marked, and the kernel entry points pull everything below them inline, so the
+// shared kernel templates end up compiled for AVX too.
+#define TRANSFORM_BATCH_INLINE inline
+#define TRANSFORM_BATCH_AVX __attribute__((target("avx")))
+#define TRANSFORM_BATCH_FLATTEN __attribute__((flatten))
+#endif
+#endif
+
+enum TransformKernel
+{
+    TRANSFORM_KERNEL_SCALAR,
+    TRANSFORM_KERNEL_SSE,
+    TRANSFORM_KERNEL_AVX
+};
+
+inline const char* transformKernelName(TransformKernel kernel)
+{
+    return kernel == TRANSFORM_KERNEL_AVX ? "avx" : kernel == TRANSFORM_KERNEL_SSE ? "sse" : "scalar";
+}
+
+// translation, rotation and scale of N objects, one array per component
+struct TransformBatch
+{
+    std::vector<float> tx, ty, tz;
+    // Euler angles in degrees in rx, ry, rz; or a quaternion in rx, ry, rz (vector part) and rw
+    std::vector<float> rx, ry, rz, rw;
+    std::vector<float> sx, sy, sz;
+    bool quaternions;
+
+    explicit TransformBatch(bool quaternions = false) : quaternions(quaternions)
+    {
+    }
+
+    size_t size() const { return tx.size(); }
+
+    void reserve(size_t count)
+    {
+        std::vector<float>* arrays[] = { &tx, &ty, &tz, &rx, &ry, &rz, &rw, &sx, &sy, &sz };
+        for (std::vector<float>* array : arrays)
+            array->reserve(count);
+    }
+
+    void clear()
+    {
+        std::vector<float>* arrays[] = { &tx, &ty, &tz, &rx, &ry, &rz, &rw, &sx, &sy, &sz };
+        for (std::vector<float>* array : arrays)
+            array->clear();
+    }
+
+    // Euler batches only
+    void add(const Transform& transform)
+    {
+        push(transform.translation, glm::vec4(transform.rotation, 0.0f), transform.scale);
+    }
+
+    // quaternion batches only
+    void add(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale)
+    {
+        push(translation, glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w), scale);
+    }
+
+private:
+    void push(const glm::vec3& translation, const glm::vec4& rotation, const glm::vec3& scale)
+    {
+        tx.push_back(translation.x);
+        ty.push_back(translation.y);
+        tz.push_back(translation.z);
+        rx.push_back(rotation.x);
+        ry.push_back(rotation.y);
+        rz.push_back(rotation.z);
+        rw.push_back(rotation.w);
+        sx.push_back(scale.x);
+        sy.push_back(scale.y);
+        sz.push_back(scale.z);
+    }
+};
+
+namespace transform_batch_detail
+{
+    const float DEGREES_TO_RADIANS = 0.01745329251994329577f;
+
+    // One lane type per instruction set; the kernels below are written once against them.
+    // Scalar: one object at a time, with the C library's sine and cosine.
+    struct Scalar
+    {
+        static const size_t WIDTH = 1;
+        float v;
+
+        Scalar(float v) : v(v) {}
+        static Scalar load(const float* p) { return Scalar(*p); }
+    };
+    inline Scalar operator+(Scalar a, Scalar b) { return Scalar(a.v + b.v); }
+    inline Scalar operator-(Scalar a, Scalar b) { return Scalar(a.v - b.v); }
+    inline Scalar operator*(Scalar a, Scalar b) { return Scalar(a.v * b.v); }
+    inline void sincos(Scalar x, Scalar& s, Scalar& c)
+    {
+        s = Scalar(std::sin(x.v));
+        c = Scalar(std::cos(x.v));
+    }
+    // columns[c * 4 + row] of one matrix
+    inline void store(const Scalar* columns, float* out, size_t)
+    {
+        for (int i = 0; i < 16; i++)
+            out[i] = columns[i].v;
+    }
+
+#ifdef TRANSFORM_BATCH_X86
+    // Sine and cosine of a whole register: the angle is reduced to [-pi/4, pi/4] around the
+    // nearest multiple of pi/2 (subtracted in three parts so no precision is lost), both
+    // minimax polynomials are evaluated, and the quadrant picks and signs the results.
+    // The error is a few units in the last place for the angles a scene uses.
+    const float TWO_OVER_PI = 0.636619772367581343f;
+    const float HALF_PI_1 = 1.5703125f;
+    const float HALF_PI_2 = 4.837512969970703125e-4f;
+    const float HALF_PI_3 = 7.54978995489188216e-8f;
+    const float SIN_1 = -1.6666654611e-1f, SIN_2 = 8.3321608736e-3f, SIN_3 = -1.9515295891e-4f;
+    const float COS_1 = 4.166664568298827e-2f, COS_2 = -1.388731625493765e-3f, COS_3 = 2.443315711809948e-5f;
+
+    // SSE: four objects; SSE2 is always there on x64 and on MSVC's x86 default
+    struct Sse
+    {
+        static const size_t WIDTH = 4;
+        __m128 v;
+
+        Sse(__m128 v) : v(v) {}
+        Sse(float f) : v(_mm_set1_ps(f)) {}
+        static Sse load(const float* p) { return Sse(_mm_loadu_ps(p)); }
+    };
+    TRANSFORM_BATCH_INLINE Sse operator+(Sse a, Sse b) { return Sse(_mm_add_ps(a.v, b.v)); }
+    TRANSFORM_BATCH_INLINE Sse operator-(Sse a, Sse b) { return Sse(_mm_sub_ps(a.v, b.v)); }
+    TRANSFORM_BATCH_INLINE Sse operator*(Sse a, Sse b) { return Sse(_mm_mul_ps(a.v, b.v)); }
+    TRANSFORM_BATCH_INLINE void sincos(Sse x, Sse& s, Sse& c)
+    {
+        __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x.v, _mm_set1_ps(TWO_OVER_PI)));
+        __m128 q = _mm_cvtepi32_ps(quadrant);
+        __m128 r = _mm_sub_ps(x.v, _mm_mul_ps(q, _mm_set1_ps(HALF_PI_1)));
+        r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(HALF_PI_2)));
+        r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(HALF_PI_3)));
+        __m128 r2 = _mm_mul_ps(r, r);
+        __m128 ps = _mm_add_ps(_mm_set1_ps(SIN_2), _mm_mul_ps(r2, _mm_set1_ps(SIN_3)));
+        ps = _mm_add_ps(_mm_set1_ps(SIN_1), _mm_mul_ps(r2, ps));
+        ps = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, r2), ps));
+        __m128 pc = _mm_add_ps(_mm_set1_ps(COS_2), _mm_mul_ps(r2, _mm_set1_ps(COS_3)));
+        pc = _mm_add_ps(_mm_set1_ps(COS_1), _mm_mul_ps(r2, pc));
+        pc = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(r2, _mm_set1_ps(0.5f))), _mm_mul_ps(_mm_mul_ps(r2, r2), pc));
+        // odd quadrants swap sine and cosine; bit 1 of the quadrant (of quadrant + 1 for the cosine) flips the sign
+        const __m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2);
+        __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+        __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, two), 30));
+        __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), two), 30));
+        s = Sse(_mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, pc), _mm_andnot_ps(swap, ps)), sinSign));
+        c = Sse(_mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, ps), _mm_andnot_ps(swap, pc)), cosSign));
+    }
+    // the registers hold one matrix element of four objects; transposing each column's
+    // x, y, z, w turns them into that column of each object
+    TRANSFORM_BATCH_INLINE void store(const Sse* columns, float* out, size_t stride)
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            __m128 x = columns[column * 4].v, y = columns[column * 4 + 1].v;
+            __m128 z = columns[column * 4 + 2].v, w = columns[column * 4 + 3].v;
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            _mm_storeu_ps(out + column * 4, x);
+            _mm_storeu_ps(out + stride + column * 4, y);
+            _mm_storeu_ps(out + 2 * stride + column * 4, z);
+            _mm_storeu_ps(out + 3 * stride + column * 4, w);
+        }
+    }
+
+    // AVX: eight objects. Only AVX, not AVX2, is assumed, so the quadrant is worked out
+    // with float arithmetic instead of integer instructions.
+    struct Avx
+    {
+        static const size_t WIDTH = 8;
+        __m256 v;
+
+        TRANSFORM_BATCH_AVX Avx(__m256 v) : v(v) {}
+        TRANSFORM_BATCH_AVX Avx(float f) : v(_mm256_set1_ps(f)) {}
+        TRANSFORM_BATCH_AVX static Avx load(const float* p) { return Avx(_mm256_loadu_ps(p)); }
+    };
+    TRANSFORM_BATCH_AVX TRANSFORM_BATCH_INLINE Avx operator+(Avx a, Avx b) { return Avx(_mm256_add_ps(a.v, b.v)); }
+    TRANSFORM_BATCH_AVX TRANSFORM_BATCH_INLINE Avx operator-(Avx a, Avx b) { return Avx(_mm256_sub_ps(a.v, b.v)); }
+    TRANSFORM_BATCH_AVX TRANSFORM_BATCH_INLINE Avx operator*(Avx a, Avx b) { return Avx(_mm256_mul_ps(a.v, b.v)); }
+    TRANSFORM_BATCH_AVX TRANSFORM_BATCH_INLINE void sincos(Avx x, Avx& s, Avx& c)
+    {
+        __m256 q = _mm256_round_ps(_mm256_mul_ps(x.v, _mm256_set1_ps(TWO_OVER_PI)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256 r = _mm256_sub_ps(x.v, _mm256_mul_ps(q, _mm256_set1_ps(HALF_PI_1)));
+        r = _mm256_sub_ps(r, _mm256_mul_ps(q, _mm256_set1_ps(HALF_PI_2)));
+        r = _mm256_sub_ps(r, _mm256_mul_ps(q, _mm256_set1_ps(HALF_PI_3)));
+        __m256 r2 = _mm256_mul_ps(r, r);
+        __m256 ps = _mm256_add_ps(_mm256_set1_ps(SIN_2), _mm256_mul_ps(r2, _mm256_set1_ps(SIN_3)));
+        ps = _mm256_add_ps(_mm256_set1_ps(SIN_1), _mm256_mul_ps(r2, ps));
+        ps = _mm256_add_ps(r, _mm256_mul_ps(_mm256_mul_ps(r, r2), ps));
+        __m256 pc = _mm256_add_ps(_mm256_set1_ps(COS_2), _mm256_mul_ps(r2, _mm256_set1_ps(COS_3)));
+        pc = _mm256_add_ps(_mm256_set1_ps(COS_1), _mm256_mul_ps(r2, pc));
+        pc = _mm256_add_ps(_mm256_sub_ps(_mm256_set1_ps(1.0f), _mm256_mul_ps(r2, _mm256_set1_ps(0.5f))), _mm256_mul_ps(_mm256_mul_ps(r2, r2), pc));
+        // quadrant mod 4, as 0, 1, 2 or 3
+        __m256 quadrant = _mm256_sub_ps(q, _mm256_mul_ps(_mm256_floor_ps(_mm256_mul_ps(q, _mm256_set1_ps(0.25f))), _mm256_set1_ps(4.0f)));
+        __m256 one = _mm256_cmp_ps(quadrant, _mm256_set1_ps(1.0f), _CMP_EQ_OQ);
+        __m256 two = _mm256_cmp_ps(quadrant, _mm256_set1_ps(2.0f), _CMP_EQ_OQ);
+        __m256 three = _mm256_cmp_ps(quadrant, _mm256_set1_ps(3.0f), _CMP_EQ_OQ);
+        __m256 signBit = _mm256_set1_ps(-0.0f);
+        __m256 swap = _mm256_or_ps(one, three);
+        __m256 sinSign = _mm256_and_ps(_mm256_or_ps(two, three), signBit);
+        __m256 cosSign = _mm256_and_ps(_mm256_or_ps(one, two), signBit);
+        // masks rather than blendv, which GCC likes to turn into per-lane branches
+        s = Avx(_mm256_xor_ps(_mm256_or_ps(_mm256_and_ps(swap, pc), _mm256_andnot_ps(swap, ps)), sinSign));
+        c = Avx(_mm256_xor_ps(_mm256_or_ps(_mm256_and_ps(swap, ps), _mm256_andnot_ps(swap, pc)), cosSign));
+    }
+    // as for SSE, once per 128-bit half
+    TRANSFORM_BATCH_AVX TRANSFORM_BATCH_INLINE void store(const Avx* columns, float* out, size_t stride)
+    {
+        for (int column = 0; column < 4; column++)
+        {
+            __m256 cx = columns[column * 4].v, cy = columns[column * 4 + 1].v;
+            __m256 cz = columns[column * 4 + 2].v, cw = columns[column * 4 + 3].v;
+            __m128 x = _mm256_castps256_ps128(cx), y = _mm256_castps256_ps128(cy);
+            __m128 z = _mm256_castps256_ps128(cz), w = _mm256_castps256_ps128(cw);
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            _mm_storeu_ps(out + column * 4, x);
+            _mm_storeu_ps(out + stride + column * 4, y);
+            _mm_storeu_ps(out + 2 * stride + column * 4, z);
+            _mm_storeu_ps(out + 3 * stride + column * 4, w);
+            x = _mm256_extractf128_ps(cx, 1);
+            y = _mm256_extractf128_ps(cy, 1);
+            z = _mm256_extractf128_ps(cz, 1);
+            w = _mm256_extractf128_ps(cw, 1);
+            _MM_TRANSPOSE4_PS(x, y, z, w);
+            _mm_storeu_ps(out + 4 * stride + column * 4, x);
+            _mm_storeu_ps(out + 5 * stride + column * 4, y);
+            _mm_storeu_ps(out + 6 * stride + column * 4, z);
+            _mm_storeu_ps(out + 7 * stride + column * 4, w);
+        }
+    }
+#endif
+
+    // T * Rx * Ry * Rz * S for objects i .. i + WIDTH - 1
+    template <typename Lane>
+    TRANSFORM_BATCH_INLINE void composeEuler(const TransformBatch& batch, size_t i, float* out, size_t stride)
+    {
+        Lane sinX(0.0f), cosX(0.0f), sinY(0.0f), cosY(0.0f), sinZ(0.0f), cosZ(0.0f);
+        Lane toRadians(DEGREES_TO_RADIANS);
+        sincos(Lane::load(&batch.rx[i]) * toRadians, sinX, cosX);
+        sincos(Lane::load(&batch.ry[i]) * toRadians, sinY, cosY);
+        sincos(Lane::load(&batch.rz[i]) * toRadians, sinZ, cosZ);
+        Lane scaleX = Lane::load(&batch.sx[i]), scaleY = Lane::load(&batch.sy[i]), scaleZ = Lane::load(&batch.sz[i]);
+        Lane sinXsinY = sinX * sinY, cosXsinY = cosX * sinY;
+        Lane zero(0.0f), one(1.0f);
+        Lane columns[16] = {
+            cosY * cosZ * scaleX, (sinXsinY * cosZ + cosX * sinZ) * scaleX, (sinX * sinZ - cosXsinY * cosZ) * scaleX, zero,
+            zero - cosY * sinZ * scaleY, (cosX * cosZ - sinXsinY * sinZ) * scaleY, (cosXsinY * sinZ + sinX * cosZ) * scaleY, zero,
+            sinY * scaleZ, zero - sinX * cosY * scaleZ, cosX * cosY * scaleZ, zero,
+            Lane::load(&batch.tx[i]), Lane::load(&batch.ty[i]), Lane::load(&batch.tz[i]), one
+        };
+        store(columns, out + i * stride, stride);
+    }
+
+    // T * R(q) * S for objects i .. i + WIDTH - 1
+    template <typename Lane>
+    TRANSFORM_BATCH_INLINE void composeQuaternion(const TransformBatch& batch, size_t i, float* out, size_t stride)
+    {
+        Lane x = Lane::load(&batch.rx[i]), y = Lane::load(&batch.ry[i]), z = Lane::load(&batch.rz[i]), w = Lane::load(&batch.rw[i]);
+        Lane x2 = x + x, y2 = y + y, z2 = z + z;
+        Lane xx = x * x2, yy = y * y2, zz = z * z2;
+        Lane xy = x * y2, xz = x * z2, yz = y * z2;
+        Lane wx = w * x2, wy = w * y2, wz = w * z2;
+        Lane scaleX = Lane::load(&batch.sx[i]), scaleY = Lane::load(&batch.sy[i]), scaleZ = Lane::load(&batch.sz[i]);
+        Lane zero(0.0f), one(1.0f);
+        Lane columns[16] = {
+            (one - yy - zz) * scaleX, (xy + wz) * scaleX, (xz - wy) * scaleX, zero,
+            (xy - wz) * scaleY, (one - xx - zz) * scaleY, (yz + wx) * scaleY, zero,
+            (xz + wy) * scaleZ, (yz - wx) * scaleZ, (one - xx - yy) * scaleZ, zero,
+            Lane::load(&batch.tx[i]), Lane::load(&batch.ty[i]), Lane::load(&batch.tz[i]), one
+        };
+        store(columns, out + i * stride, stride);
+    }
+
+    // whole registers while they last, then the rest one at a time
+    template <typename Lane>
+    TRANSFORM_BATCH_INLINE void composeRange(const TransformBatch& batch, size_t first, size_t end, float* out, size_t stride)
+    {
+        size_t i = first;
+        if (batch.quaternions)
+        {
+            for (; i + Lane::WIDTH <= end; i += Lane::WIDTH)
+                composeQuaternion<Lane>(batch, i, out, stride);
+            for (; i < end; i++)
+                composeQuaternion<Scalar>(batch, i, out, stride);
+        }
+        else
+        {
+            for (; i + Lane::WIDTH <= end; i += Lane::WIDTH)
+                composeEuler<Lane>(batch, i, out, stride);
+            for (; i < end; i++)
+                composeEuler<Scalar>(batch, i, out, stride);
+        }
+    }
+
+    inline void composeScalar(const TransformBatch& batch, size_t first, size_t end, float* out, size_t stride)
+    {
+        composeRange<Scalar>(batch, first, end, out, stride);
+    }
+
+#ifdef TRANSFORM_BATCH_X86
+    TRANSFORM_BATCH_FLATTEN inline void composeSse(const TransformBatch& batch, size_t first, size_t end, float* out, size_t stride)
+    {
+        composeRange<Sse>(batch, first, end, out, stride);
+    }
+
+    TRANSFORM_BATCH_AVX TRANSFORM_BATCH_FLATTEN inline void composeAvx(const TransformBatch& batch, size_t first, size_t end, float* out, size_t stride)
+    {
+        composeRange<Avx>(batch, first, end, out, stride);
+        // leaving AVX code with dirty upper halves slows down SSE code that follows
+        _mm256_zeroupper();
+    }
+
+    // AVX needs the CPU instructions and the OS saving the wider registers
+    inline bool cpuHasAvx()
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+        return osxsave && avx && (_xgetbv(0) & 6) == 6;
+#else
+        __builtin_cpu_init();
+        return __builtin_cpu_supports("avx") != 0;
+#endif
+    }
+#endif
+}
+
+// the widest kernel this CPU runs
+inline TransformKernel bestTransformKernel()
+{
+#ifdef TRANSFORM_BATCH_X86
+    static const TransformKernel best = transform_batch_detail::cpuHasAvx() ? TRANSFORM_KERNEL_AVX : TRANSFORM_KERNEL_SSE;
+    return best;
+#else
+    return TRANSFORM_KERNEL_SCALAR;
+#endif
+}
+
+// Compose the world matrices of objects [first, end) of the batch. Object i's column-major
+// matrix goes to out + i * stride floats: stride 16 for a plain mat4 array, or
+// ObjectBuffer::TEXELS_PER_OBJECT * 4 to write the object buffer's texels in place.
+// A kernel the CPU lacks falls back to the best one it has.
+inline void composeTransforms(const TransformBatch& batch, size_t first, size_t end, float* out, size_t stride = 16,
+    TransformKernel kernel = bestTransformKernel())
+{
+    if (kernel > bestTransformKernel())
+        kernel = bestTransformKernel();
+#ifdef TRANSFORM_BATCH_X86
+    if (kernel == TRANSFORM_KERNEL_AVX)
+        return transform_batch_detail::composeAvx(batch, first, end, out, stride);
+    if (kernel == TRANSFORM_KERNEL_SSE)
+        return transform_batch_detail::composeSse(batch, first, end, out, stride);
+#endif
+    transform_batch_detail::composeScalar(batch, first, end, out, stride);
+}
+
+inline void composeTransforms(const TransformBatch& batch, float* out, size_t stride = 16, TransformKernel kernel = bestTransformKernel())
+{
+    composeTransforms(batch, 0, batch.size(), out, stride, kernel);
+}
+
+#endif
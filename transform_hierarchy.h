@@ -0,0 +1,206 @@
+//
+//  transform_hierarchy.h
+//  3D Object Drawing
+//
+//  Parent/child transforms stored as flat arrays. A node's world matrix is
+//  parent world * local and is cached; it is only recomputed when the node or
+//  one of its ancestors changed since the last update(). Separate changed
+//  subtrees are independent and can be recomputed on several threads.
+//  Nodes placed with a Pose also keep their world pose, as long as every
+//  ancestor was placed with one and scales uniformly; the world matrix is
+//  then T * R * S of it, which the batch composer builds (transform_batch.h).
+//
+
+#ifndef TRANSFORM_HIERARCHY_H
+#define TRANSFORM_HIERARCHY_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "job_system.h"
+
+#include <algorithm>
+#include <vector>
+
+// translation, rotation and scale of a matrix T * R * S
+struct Pose
+{
+    glm::vec3 translation;
+    glm::quat rotation;
+    glm::vec3 scale;
+
+    Pose() : translation(0.0f), rotation(1.0f, 0.0f, 0.0f, 0.0f), scale(1.0f)
+    {
+    }
+    Pose(const glm::vec3& translation, const glm::quat& rotation, const glm::vec3& scale) : translation(translation), rotation(rotation), scale(scale)
+    {
+    }
+};
+
+class TransformHierarchy
+{
+public:
+    static const int NO_PARENT = -1;
+
+    TransformHierarchy() : generation(0)
+    {
+    }
+
+    // the parent must already exist, so parents always come before their children
+    unsigned int addNode(int parent, const glm::mat4& local)
+    {
+        unsigned int node = (unsigned int)locals.size();
+        parents.push_back(parent);
+        locals.push_back(local);
+        worlds.push_back(parent == NO_PARENT ? local : worlds[parent] * local);
+        localPoses.push_back(Pose());
+        worldPoses.push_back(Pose());
+        posed.push_back(0);
+        children.push_back(std::vector<unsigned int>());
+        marked.push_back(0);
+        if (parent != NO_PARENT)
+            children[parent].push_back(node);
+        return node;
+    }
+    // local is the matrix of pose
+    unsigned int addNode(int parent, const glm::mat4& local, const Pose& pose)
+    {
+        unsigned int node = addNode(parent, local);
+        localPoses[node] = pose;
+        posed[node] = LOCAL_POSE;
+        updatePose(node);
+        return node;
+    }
+
+    void setLocal(unsigned int node, const glm::mat4& local)
+    {
+        locals[node] = local;
+        posed[node] = 0;
+        dirtyNodes.push_back(node);
+    }
+    void setLocal(unsigned int node, const glm::mat4& local, const Pose& pose)
+    {
+        locals[node] = local;
+        localPoses[node] = pose;
+        posed[node] = LOCAL_POSE;
+        dirtyNodes.push_back(node);
+    }
+
+    const glm::mat4& local(unsigned int node) const { return locals[node]; }
+    const glm::mat4& world(unsigned int node) const { return worlds[node]; }
+    // the world matrix as a pose, or NULL when it is not one (a node or an ancestor placed by matrix, or sheared)
+    const Pose* worldPose(unsigned int node) const { return (posed[node] & WORLD_POSE) ? &worldPoses[node] : NULL; }
+    int parent(unsigned int node) const { return parents[node]; }
+    size_t size() const { return locals.size(); }
+    // nodes whose world matrix the last update() recomputed
+    const std::vector<unsigned int>& lastUpdated() const { return changed; }
+
+    // recompute the world matrices of changed nodes and their descendants; returns how many were
+    // recomputed. With jobs, subtrees below different changed nodes are spread over the threads.
+    unsigned int update(JobSystem* jobs = NULL)
+    {
+        changed.clear();
+        if (dirtyNodes.empty())
+            return 0;
+        // ancestors have lower indices, so after sorting a subtree root comes before anything below it
+        std::sort(dirtyNodes.begin(), dirtyNodes.end());
+        dirtyNodes.erase(std::unique(dirtyNodes.begin(), dirtyNodes.end()), dirtyNodes.end());
+        generation++;
+        // a changed node below another changed node is recomputed with that one's subtree
+        roots.clear();
+        for (unsigned int node : dirtyNodes)
+            marked[node] = generation;
+        for (unsigned int node : dirtyNodes)
+        {
+            int ancestor = parents[node];
+            while (ancestor != NO_PARENT && marked[ancestor] != generation)
+                ancestor = parents[ancestor];
+            if (ancestor == NO_PARENT)
+                roots.push_back(node);
+        }
+        dirtyNodes.clear();
+
+        if (jobs == NULL || jobs->threadCount() == 1 || roots.size() < 2)
+        {
+            for (unsigned int root : roots)
+                updateSubtree(root, stack, changed);
+            return (unsigned int)changed.size();
+        }
+        // every piece collects its own list; joined in root order, the result does not depend on timing
+        size_t grain = jobs->grainFor(roots.size(), 1);
+        size_t pieces = (roots.size() + grain - 1) / grain;
+        if (pieceChanged.size() < pieces)
+        {
+            pieceChanged.resize(pieces);
+            pieceStacks.resize(pieces);
+        }
+        jobs->parallelFor(roots.size(), grain, [&](size_t first, size_t end) {
+            size_t piece = first / grain;
+            pieceChanged[piece].clear();
+            for (size_t i = first; i < end; i++)
+                updateSubtree(roots[i], pieceStacks[piece], pieceChanged[piece]);
+        });
+        for (size_t piece = 0; piece < pieces; piece++)
+            changed.insert(changed.end(), pieceChanged[piece].begin(), pieceChanged[piece].end());
+        return (unsigned int)changed.size();
+    }
+
+private:
+    // bits of posed: the node was placed with a pose, and its world pose is known
+    static const unsigned char LOCAL_POSE = 1;
+    static const unsigned char WORLD_POSE = 2;
+
+    std::vector<int> parents;
+    std::vector<glm::mat4> locals;
+    std::vector<glm::mat4> worlds;
+    std::vector<Pose> localPoses, worldPoses;
+    std::vector<unsigned char> posed;
+    std::vector<std::vector<unsigned int> > children;
+    // equal to generation for the nodes changed since the last update()
+    std::vector<unsigned int> marked;
+    std::vector<unsigned int> dirtyNodes;
+    std::vector<unsigned int> stack;
+    std::vector<unsigned int> changed;
+    std::vector<unsigned int> roots;
+    std::vector<std::vector<unsigned int> > pieceChanged, pieceStacks;
+    unsigned int generation;
+
+    void updateSubtree(unsigned int root, std::vector<unsigned int>& pending, std::vector<unsigned int>& recomputed)
+    {
+        pending.push_back(root);
+        while (!pending.empty())
+        {
+            unsigned int node = pending.back();
+            pending.pop_back();
+            int parent = parents[node];
+            worlds[node] = parent == NO_PARENT ? locals[node] : worlds[parent] * locals[node];
+            updatePose(node);
+            recomputed.push_back(node);
+            for (unsigned int child : children[node])
+                pending.push_back(child);
+        }
+    }
+
+    // parent * child stays T * R * S while the parent scales the same along every axis
+    void updatePose(unsigned int node)
+    {
+        posed[node] &= LOCAL_POSE;
+        if (!posed[node])
+            return;
+        int parent = parents[node];
+        const Pose& local = localPoses[node];
+        if (parent == NO_PARENT)
+        {
+            worldPoses[node] = local;
+            posed[node] |= WORLD_POSE;
+            return;
+        }
+        const Pose& above = worldPoses[parent];
+        if (!(posed[parent] & WORLD_POSE) || above.scale.x != above.scale.y || above.scale.x != above.scale.z)
+            return;
+        worldPoses[node] = Pose(above.translation + above.rotation * (above.scale * local.translation), above.rotation * local.rotation, above.scale * local.scale);
+        posed[node] |= WORLD_POSE;
+    }
+};
+
+#endif
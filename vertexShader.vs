@@ -1,16 +1,35 @@
 #version 330 core
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aColor;
+layout (location = 2) in uint aObject;
 
 out vec4 color;
 
+// written once per frame, shared by every program (CAMERA_BLOCK_BINDING)
+layout (std140) uniform Camera
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+};
+
+// per object: four model matrix columns, then the material color and opacity (object_buffer.h)
+uniform samplerBuffer objects;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+uniform vec4 materialColor;
+uniform bool instanced;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(aPos, 1.0f);
-    color = vec4(aColor, 1.0f);
+    mat4 world = model;
+    vec4 tint = materialColor;
+    if (instanced)
+    {
+        int texel = int(aObject) * 5;
+        world = mat4(texelFetch(objects, texel), texelFetch(objects, texel + 1), texelFetch(objects, texel + 2), texelFetch(objects, texel + 3));
+        tint = texelFetch(objects, texel + 4);
+    }
+    gl_Position = viewProjection * world * vec4(aPos, 1.0f);
+    color = vec4(aColor * tint.rgb, tint.a);
 }
@@ -0,0 +1,168 @@
+//
+//  vertex_format.h
+//  3D Object Drawing
+//
+//  How vertices and indices sit in GPU buffers. Meshes are authored (and
+//  stored in scene files) as six floats per vertex and 32-bit indices; on
+//  upload they are converted to one of two layouts:
+//    VERTEX_FLOAT   - the authored layout, 24 bytes per vertex
+//    VERTEX_COMPACT - position as three 16-bit unsigned normalized integers
+//                     over the mesh's box, color as RGBA8; 12 bytes per vertex
+//  Compact positions come back to model space through a per-mesh offset and
+//  scale that is folded into the object's model matrix, so the shader does
+//  not change. Index buffers use 16-bit indices whenever the mesh has few
+//  enough vertices. The attribute pointers come from a VertexLayout table.
+//
+
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "bounds.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+enum VertexFormat
+{
+    VERTEX_FLOAT,
+    VERTEX_COMPACT
+};
+
+struct VertexAttribute
+{
+    GLuint location;
+    GLint components;
+    GLenum type;
+    GLboolean normalized;
+    size_t offset;
+};
+
+struct VertexLayout
+{
+    GLsizei stride;
+    // position is location 0, color location 1, as in the shaders
+    VertexAttribute attributes[2];
+    unsigned int attributeCount;
+};
+
+inline const VertexLayout& vertexLayout(VertexFormat format)
+{
+    static const VertexLayout floats = { 6 * sizeof(float), {
+        { 0, 3, GL_FLOAT, GL_FALSE, 0 },
+        { 1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float) } }, 2 };
+    // the position's fourth short only pads the color to a four-byte boundary
+    static const VertexLayout compact = { 4 * sizeof(uint16_t) + 4, {
+        { 0, 3, GL_UNSIGNED_SHORT, GL_TRUE, 0 },
+        { 1, 4, GL_UNSIGNED_BYTE, GL_TRUE, 4 * sizeof(uint16_t) } }, 2 };
+    return format == VERTEX_COMPACT ? compact : floats;
+}
+
+// attribute pointers of the bound VAO, reading from the bound GL_ARRAY_BUFFER
+inline void applyVertexLayout(const VertexLayout& layout)
+{
+    for (unsigned int i = 0; i < layout.attributeCount; i++)
+    {
+        const VertexAttribute& attribute = layout.attributes[i];
+        glVertexAttribPointer(attribute.location, attribute.components, attribute.type, attribute.normalized, layout.stride, (void*)attribute.offset);
+        glEnableVertexAttribArray(attribute.location);
+    }
+}
+
+// what the stored position has to go through to be in model space: offset + scale * stored
+struct PositionDequantization
+{
+    glm::vec3 offset;
+    glm::vec3 scale;
+
+    PositionDequantization() : offset(0.0f), scale(1.0f) {}
+};
+
+// unsigned normalized values read back as value / 65535 on every GL version, so the box maps to 0..65535
+inline PositionDequantization positionDequantization(VertexFormat format, const AABB& box)
+{
+    PositionDequantization dequantization;
+    if (format == VERTEX_COMPACT && !box.empty())
+    {
+        dequantization.offset = box.min;
+        dequantization.scale = box.max - box.min;
+        // a flat mesh still needs a scale to divide by
+        for (int axis = 0; axis < 3; axis++)
+        {
+            if (dequantization.scale[axis] <= 0.0f)
+                dequantization.scale[axis] = 1.0f;
+        }
+    }
+    return dequantization;
+}
+
+// model * translate(offset) * scale(scale), without the general matrix product
+inline glm::mat4 dequantizedModel(const glm::mat4& model, const PositionDequantization& dequantization)
+{
+    glm::mat4 result;
+    result[0] = model[0] * dequantization.scale.x;
+    result[1] = model[1] * dequantization.scale.y;
+    result[2] = model[2] * dequantization.scale.z;
+    result[3] = model * glm::vec4(dequantization.offset, 1.0f);
+    return result;
+}
+
+// six-float vertices (position, color) in the given layout
+inline void encodeVertices(VertexFormat format, const float* vertices, size_t count, const PositionDequantization& dequantization, std::vector<unsigned char>& out)
+{
+    const VertexLayout& layout = vertexLayout(format);
+    out.resize(count * layout.stride);
+    if (format == VERTEX_FLOAT)
+    {
+        memcpy(out.data(), vertices, out.size());
+        return;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        const float* source = vertices + i * 6;
+        unsigned char* target = &out[i * layout.stride];
+        uint16_t position[4] = { 0, 0, 0, 0 };
+        for (int axis = 0; axis < 3; axis++)
+        {
+            float unit = (source[axis] - dequantization.offset[axis]) / dequantization.scale[axis];
+            position[axis] = (uint16_t)std::lround(std::min(std::max(unit, 0.0f), 1.0f) * 65535.0f);
+        }
+        memcpy(target, position, sizeof(position));
+        unsigned char* color = target + sizeof(position);
+        for (int channel = 0; channel < 3; channel++)
+            color[channel] = (unsigned char)std::lround(std::min(std::max(source[3 + channel], 0.0f), 1.0f) * 255.0f);
+        color[3] = 255;
+    }
+}
+
+// the smallest index type that reaches every vertex
+inline GLenum indexTypeFor(size_t vertexCount)
+{
+    return vertexCount <= 0x10000 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+}
+
+inline size_t indexSize(GLenum type)
+{
+    return type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+// 32-bit indices as the given type; the caller has checked they fit
+inline void encodeIndices(GLenum type, const unsigned int* indices, size_t count, std::vector<unsigned char>& out)
+{
+    out.resize(count * indexSize(type));
+    if (type == GL_UNSIGNED_INT)
+    {
+        memcpy(out.data(), indices, out.size());
+        return;
+    }
+    uint16_t* target = (uint16_t*)out.data();
+    for (size_t i = 0; i < count; i++)
+        target[i] = (uint16_t)indices[i];
+}
+
+#endif